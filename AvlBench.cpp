@@ -0,0 +1,631 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#if AVL_BENCH_HAS_ABSL
+#include <absl/container/btree_set.h>
+#endif
+
+#include "AvlTree.cpp"
+
+#ifndef AVL_BENCH_MAX_KEYS
+#define AVL_BENCH_MAX_KEYS 100000000
+#endif
+
+
+/**
+ * Order in which the keys are inserted, removed & searched.
+ */
+enum class Distribution {
+    Sequential,
+    Random,
+    Zipfian,
+};
+
+// Bytes currently allocated through CountingAllocator, the benchmarks run on one thread.
+static std::size_t live_bytes{0};
+
+/**
+ * std::allocator counting the bytes it holds, to report the memory used per key.
+ *
+ * @tparam T type of the allocated objects.
+ */
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t count) {
+        live_bytes += count * sizeof(T);
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T *pointer, std::size_t count) noexcept {
+        live_bytes -= count * sizeof(T);
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>&) const noexcept {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>&) const noexcept {
+        return false;
+    }
+};
+
+/**
+ * Zipfian ranks in [0, n), by rejection-inversion sampling (Hörmann & Derflinger),
+ * in O(1) memory so it scales to the largest trees.
+ */
+class ZipfianGenerator {
+public:
+    /**
+     * @param n number of ranks.
+     * @param skew exponent of the distribution, rank r is drawn with probability ~ 1 / (r + 1)^skew.
+     */
+    explicit ZipfianGenerator(std::size_t n, double skew = 0.99):
+        n{static_cast<double>(n)}, skew{skew},
+        integral_first{hIntegral(1.5) - 1}, integral_last{hIntegral(this->n + 0.5)},
+        threshold{2 - hIntegralInverse(hIntegral(2.5) - h(2))} {}
+
+    /**
+     * @param random source of uniform bits.
+     * @return rank in [0, n), small ranks are the most frequent.
+     */
+    std::size_t operator()(std::mt19937_64& random) {
+        std::uniform_real_distribution<double> uniform{0, 1};
+
+        while (true) {
+            const double u{integral_last + uniform(random) * (integral_first - integral_last)};
+            const double x{hIntegralInverse(u)};
+            const double k{std::clamp(std::floor(x + 0.5), 1.0, n)};
+
+            if (k - x <= threshold or u >= hIntegral(k + 0.5) - h(k)) {
+                return static_cast<std::size_t>(k) - 1;
+            }
+        }
+    }
+private:
+    [[nodiscard]] double h(double x) const {
+        return std::exp(-skew * std::log(x));
+    }
+
+    [[nodiscard]] double hIntegral(double x) const {
+        const double log_x{std::log(x)};
+        const double t{(1 - skew) * log_x};
+        return (std::abs(t) > 1e-8 ? std::expm1(t) / t : 1 + t / 2) * log_x;
+    }
+
+    [[nodiscard]] double hIntegralInverse(double x) const {
+        const double t{x * (1 - skew)};
+        return std::exp((std::abs(t) > 1e-8 ? std::log1p(t) / t : 1 - t / 2) * x);
+    }
+
+    double n;
+    double skew;
+    double integral_first;
+    double integral_last;
+    double threshold;
+};
+
+/**
+ * @param n number of distinct keys.
+ * @param distribution of the ranks.
+ * @return n ranks in [0, n): ascending, a random permutation, or Zipfian draws with repeats.
+ */
+std::vector<std::size_t> makeRanks(std::size_t n, Distribution distribution) {
+    std::vector<std::size_t> ranks(n);
+    std::mt19937_64 random{n};
+
+    switch (distribution) {
+        case Distribution::Sequential:
+            std::iota(ranks.begin(), ranks.end(), std::size_t{0});
+            break;
+        case Distribution::Random:
+            std::iota(ranks.begin(), ranks.end(), std::size_t{0});
+            std::shuffle(ranks.begin(), ranks.end(), random);
+            break;
+        case Distribution::Zipfian: {
+            ZipfianGenerator zipfian{n};
+
+            // scatters the hot ranks over the whole key space
+            for (auto& rank: ranks) {
+                rank = static_cast<std::size_t>(zipfian(random) * 0x9E3779B97F4A7C15ull % n);
+            }
+
+            break;
+        }
+    }
+
+    return ranks;
+}
+
+/**
+ * @param rank of the key.
+ * @return key of the rank, keys sort in the order of their ranks.
+ */
+template <typename T>
+T makeKey(std::size_t rank) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        char digits[24];
+        std::snprintf(digits, sizeof(digits), "key%016llu", static_cast<unsigned long long>(rank));
+        return digits;
+    } else {
+        return static_cast<T>(rank);
+    }
+}
+
+/**
+ * @param ranks to be converted.
+ * @return keys of the ranks, in the same order.
+ */
+template <typename T>
+std::vector<T> makeKeys(const std::vector<std::size_t>& ranks) {
+    std::vector<T> keys;
+    keys.reserve(ranks.size());
+
+    for (const auto rank: ranks) {
+        keys.push_back(makeKey<T>(rank));
+    }
+
+    return keys;
+}
+
+template <typename C>
+struct is_avl: std::false_type {};
+
+template <typename T, typename Compare, typename Allocator, typename NodePolicy>
+struct is_avl<AVL<T, Compare, Allocator, NodePolicy>>: std::true_type {};
+
+/**
+ * @param container to be searched.
+ * @param key to be searched for.
+ * @return true if the key is present.
+ */
+template <typename Container, typename T>
+bool containsKey(const Container& container, const T& key) {
+    if constexpr (is_avl<Container>::value) {
+        return container.search(key);
+    } else {
+        return container.find(key) != container.end();
+    }
+}
+
+/**
+ * @param container to be modified.
+ * @param key to be removed.
+ */
+template <typename Container, typename T>
+void removeKey(Container& container, const T& key) {
+    if constexpr (is_avl<Container>::value) {
+        container.remove(key);
+    } else {
+        container.erase(key);
+    }
+}
+
+/**
+ * @param container to be visited.
+ * @param low smallest key visited.
+ * @param high largest key visited.
+ * @return number of keys in [low, high].
+ */
+template <typename Container, typename T>
+std::size_t visitRange(const Container& container, const T& low, const T& high) {
+    std::size_t visited{0};
+
+    if constexpr (is_avl<Container>::value) {
+        for (const auto& key: container.range(low, high)) {
+            benchmark::DoNotOptimize(key);
+            visited++;
+        }
+    } else {
+        for (auto it{container.lower_bound(low)}; it != container.end() and not (high < *it); ++it) {
+            benchmark::DoNotOptimize(*it);
+            visited++;
+        }
+    }
+
+    return visited;
+}
+
+/**
+ * Wall clock of the timed parts of a benchmark, paused & resumed along with the state,
+ * so the time per operation is reported as a plain counter.
+ */
+class OperationClock {
+public:
+    /**
+     * @param state of the benchmark, paused & resumed by the clock.
+     */
+    explicit OperationClock(benchmark::State& state): state{state} {}
+
+    void start() {
+        started = std::chrono::steady_clock::now();
+    }
+
+    void stop() {
+        elapsed += std::chrono::steady_clock::now() - started;
+    }
+
+    void pause() {
+        stop();
+        state.PauseTiming();
+    }
+
+    void resume() {
+        state.ResumeTiming();
+        start();
+    }
+
+    /**
+     * @param n number of operations per iteration.
+     * @return counter reporting the mean time of one operation, in nanoseconds.
+     */
+    [[nodiscard]] benchmark::Counter nanosecondsPerOperation(std::size_t n) const {
+        const auto operations{static_cast<double>(state.iterations()) * static_cast<double>(std::max<std::size_t>(n, 1))};
+        return benchmark::Counter(std::chrono::duration<double, std::nano>(elapsed).count() / operations);
+    }
+private:
+    benchmark::State& state;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::duration elapsed{0};
+};
+
+/**
+ * Inserts n keys in the order of the distribution into an empty container.
+ */
+template <typename Container, typename T>
+void benchInsert(benchmark::State& state, Distribution distribution) {
+    const auto n{static_cast<std::size_t>(state.range(0))};
+    const auto keys{makeKeys<T>(makeRanks(n, distribution))};
+    double bytes_per_key{0};
+
+    OperationClock timer{state};
+    timer.start();
+    for (auto _: state) {
+        Container container;
+        const std::size_t before{live_bytes};
+
+        for (const auto& key: keys) {
+            container.insert(key);
+        }
+
+        timer.pause();
+        bytes_per_key = static_cast<double>(live_bytes - before) / static_cast<double>(container.size());
+        container.clear();
+        timer.resume();
+    }
+    timer.stop();
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * n));
+    state.counters["ns_per_op"] = timer.nanosecondsPerOperation(n);
+    state.counters["bytes_per_key"] = bytes_per_key;
+}
+
+/**
+ * Removes n keys in the order of the distribution from a container holding all of them.
+ */
+template <typename Container, typename T>
+void benchRemove(benchmark::State& state, Distribution distribution) {
+    const auto n{static_cast<std::size_t>(state.range(0))};
+    const auto keys{makeKeys<T>(makeRanks(n, Distribution::Sequential))};
+    const auto order{makeKeys<T>(makeRanks(n, distribution))};
+
+    OperationClock timer{state};
+    timer.start();
+    for (auto _: state) {
+        timer.pause();
+        Container container;
+
+        for (const auto& key: keys) {
+            container.insert(key);
+        }
+
+        timer.resume();
+
+        for (const auto& key: order) {
+            removeKey(container, key);
+        }
+
+        timer.pause();
+        container.clear();
+        timer.resume();
+    }
+    timer.stop();
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * n));
+    state.counters["ns_per_op"] = timer.nanosecondsPerOperation(n);
+}
+
+/**
+ * Searches n keys in the order of the distribution in a container holding all of them.
+ */
+template <typename Container, typename T>
+void benchSearch(benchmark::State& state, Distribution distribution) {
+    const auto n{static_cast<std::size_t>(state.range(0))};
+    const auto keys{makeKeys<T>(makeRanks(n, Distribution::Sequential))};
+    const auto order{makeKeys<T>(makeRanks(n, distribution))};
+    Container container;
+
+    for (const auto& key: keys) {
+        container.insert(key);
+    }
+
+    OperationClock timer{state};
+    timer.start();
+    for (auto _: state) {
+        std::size_t found{0};
+
+        for (const auto& key: order) {
+            found += containsKey(container, key);
+        }
+
+        benchmark::DoNotOptimize(found);
+    }
+    timer.stop();
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * n));
+    state.counters["ns_per_op"] = timer.nanosecondsPerOperation(n);
+}
+
+/**
+ * Looks up n keys in a container of n keys, with search_batch() for the tree
+ * & one lookup after the other for the others.
+ */
+template <typename Container, typename T>
+void benchSearchBatch(benchmark::State& state, Distribution distribution) {
+    const auto n{static_cast<std::size_t>(state.range(0))};
+    const auto keys{makeKeys<T>(makeRanks(n, Distribution::Sequential))};
+    const auto order{makeKeys<T>(makeRanks(n, distribution))};
+    Container container;
+
+    for (const auto& key: keys) {
+        container.insert(key);
+    }
+
+    OperationClock timer{state};
+
+    if constexpr (is_avl<Container>::value) {
+        std::vector<typename Container::Node*> results(n);
+
+        timer.start();
+        for (auto _: state) {
+            container.search_batch(order.begin(), order.end(), results.begin());
+            benchmark::DoNotOptimize(results.data());
+        }
+        timer.stop();
+    } else {
+        timer.start();
+        for (auto _: state) {
+            std::size_t found{0};
+
+            for (const auto& key: order) {
+                found += containsKey(container, key);
+            }
+
+            benchmark::DoNotOptimize(found);
+        }
+        timer.stop();
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * n));
+    state.counters["ns_per_op"] = timer.nanosecondsPerOperation(n);
+}
+
+/**
+ * Builds a container from n sorted keys, with build_from_sorted() for the tree
+ * & hinted insertions at the end for the others.
+ */
+template <typename Container, typename T>
+void benchBulkBuild(benchmark::State& state, Distribution) {
+    const auto n{static_cast<std::size_t>(state.range(0))};
+    const auto keys{makeKeys<T>(makeRanks(n, Distribution::Sequential))};
+
+    OperationClock timer{state};
+    timer.start();
+    for (auto _: state) {
+        if constexpr (is_avl<Container>::value) {
+            auto container{Container::build_from_sorted(keys.begin(), keys.end())};
+            timer.pause();
+        } else {
+            Container container;
+
+            for (const auto& key: keys) {
+                container.insert(container.end(), key);
+            }
+
+            timer.pause();
+        }
+
+        timer.resume();
+    }
+    timer.stop();
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * n));
+    state.counters["ns_per_op"] = timer.nanosecondsPerOperation(n);
+}
+
+/**
+ * Visits windows of 100 consecutive keys, starting at keys drawn from the distribution.
+ */
+template <typename Container, typename T>
+void benchRange(benchmark::State& state, Distribution distribution) {
+    constexpr std::size_t window{100};
+    constexpr std::size_t queries{1024};
+
+    const auto n{static_cast<std::size_t>(state.range(0))};
+    const auto keys{makeKeys<T>(makeRanks(n, Distribution::Sequential))};
+    auto starts{makeRanks(n, distribution)};
+    starts.resize(std::min(n, queries));
+    Container container;
+
+    for (const auto& key: keys) {
+        container.insert(key);
+    }
+
+    std::vector<std::pair<T, T>> bounds;
+
+    for (const auto start: starts) {
+        bounds.emplace_back(makeKey<T>(start), makeKey<T>(std::min(n - 1, start + window - 1)));
+    }
+
+    std::size_t visited{0};
+
+    OperationClock timer{state};
+    timer.start();
+    for (auto _: state) {
+        for (const auto& [low, high]: bounds) {
+            visited += visitRange(container, low, high);
+        }
+    }
+    timer.stop();
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(visited));
+    state.counters["ns_per_op"] = timer.nanosecondsPerOperation(bounds.size());
+}
+
+/**
+ * Iterates over every key of a container of n keys, in order.
+ */
+template <typename Container, typename T>
+void benchIterate(benchmark::State& state, Distribution) {
+    const auto n{static_cast<std::size_t>(state.range(0))};
+    const auto keys{makeKeys<T>(makeRanks(n, Distribution::Sequential))};
+    Container container;
+
+    for (const auto& key: keys) {
+        container.insert(key);
+    }
+
+    OperationClock timer{state};
+    timer.start();
+    for (auto _: state) {
+        for (const auto& key: container) {
+            benchmark::DoNotOptimize(key);
+        }
+    }
+    timer.stop();
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * n));
+    state.counters["ns_per_op"] = timer.nanosecondsPerOperation(n);
+}
+
+/**
+ * Registers every operation on one container & key type, for every distribution & size.
+ *
+ * @param container name of the container in the benchmark names.
+ * @param key name of the key type in the benchmark names.
+ */
+template <typename Container, typename T>
+void registerContainer(const std::string& container, const std::string& key) {
+    using Bench = void (*)(benchmark::State&, Distribution);
+
+    const std::pair<const char*, Bench> operations[]{
+        {"insert", benchInsert<Container, T>},
+        {"remove", benchRemove<Container, T>},
+        {"search", benchSearch<Container, T>},
+        {"search_batch", benchSearchBatch<Container, T>},
+        {"bulk_build", benchBulkBuild<Container, T>},
+        {"range", benchRange<Container, T>},
+        {"iterate", benchIterate<Container, T>},
+    };
+
+    const std::pair<const char*, Distribution> distributions[]{
+        {"sequential", Distribution::Sequential},
+        {"random", Distribution::Random},
+        {"zipfian", Distribution::Zipfian},
+    };
+
+    for (const auto& [operation, bench]: operations) {
+        for (const auto& [distribution_name, distribution]: distributions) {
+            // bulk builds & full iterations do not depend on the distribution
+            const bool ordered{bench == benchBulkBuild<Container, T> or bench == benchIterate<Container, T>};
+
+            if (ordered and distribution != Distribution::Sequential) {
+                continue;
+            }
+
+            const std::string name{std::string(operation) + "/" + container + "/" + key + "/" + distribution_name};
+            auto *registered{benchmark::RegisterBenchmark(name.c_str(), bench, distribution)};
+            registered->RangeMultiplier(10)->Range(1000, AVL_BENCH_MAX_KEYS)->Unit(benchmark::kMillisecond);
+        }
+    }
+}
+
+/**
+ * Registers the tree & its baselines for one key type.
+ *
+ * @param key name of the key type in the benchmark names.
+ */
+template <typename T>
+void registerKey(const std::string& key) {
+    registerContainer<AVL<T, std::less<T>, CountingAllocator<T>>, T>("avl", key);
+    registerContainer<std::set<T, std::less<T>, CountingAllocator<T>>, T>("std_set", key);
+#if AVL_BENCH_HAS_ABSL
+    registerContainer<absl::btree_set<T, std::less<T>, CountingAllocator<T>>, T>("absl_btree_set", key);
+#endif
+}
+
+/**
+ * Benchmark names are operation/container/key/distribution/size, filter them with --benchmark_filter.
+ * JSON results are written with --benchmark_out=<file> --benchmark_out_format=json.
+ */
+int main(int argc, char **argv) {
+    registerKey<int>("int");
+    registerKey<std::uint64_t>("uint64");
+    registerKey<std::string>("string");
+
+    benchmark::Initialize(&argc, argv);
+
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,967 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "AvlMultiset.cpp"
+#include "AvlTree.cpp"
+#include "IntervalTree.cpp"
+#include "MappedAvl.cpp"
+#include "NodePool.cpp"
+#include "ShardedAvl.cpp"
+#include "StaticAvl.cpp"
+
+
+/**
+ * Differential fuzzer of the tree against std::set: the input is decoded as a stream of operations,
+ * applied to both, & every result & the whole content are compared after each of them, along with validate().
+ * The map, multiset, sharded, interval & static front-ends are checked the same way against their std
+ * counterparts or a brute force scan, the images & frozen trees through their lookups.
+ * Built as a libFuzzer target, or with AVL_FUZZ_STANDALONE as a randomized loop, see main().
+ */
+
+// Keys are drawn from a small range, so removals & lookups often hit.
+static constexpr int fuzz_key_range{128};
+
+// StaticAVL is also checked at compile time, where its constexpr paths must evaluate.
+static constexpr StaticAVL<int, 8> fuzz_static{9, 3, 7, 1, 5, 3, 11};
+
+static_assert(fuzz_static.size() == 6 and fuzz_static.capacity() == 8, "StaticAVL size() differs");
+static_assert(fuzz_static.contains(7) and not fuzz_static.contains(4), "StaticAVL contains() differs");
+static_assert(*fuzz_static.lower_bound(4) == 5 and *fuzz_static.lower_bound(5) == 5, "StaticAVL lower_bound() differs");
+static_assert(*fuzz_static.upper_bound(9) == 11 and not fuzz_static.upper_bound(11), "StaticAVL upper_bound() differs");
+static_assert(fuzz_static.height() == 3, "StaticAVL height() differs");
+
+/**
+ * Reports the failed check & aborts, so the fuzzer records the input.
+ *
+ * @param condition expected to hold.
+ * @param what description of the check.
+ */
+static void fuzzCheck(bool condition, const char *what) {
+    if (not condition) {
+        std::fprintf(stderr, "avl_fuzz: %s\n", what);
+        std::abort();
+    }
+}
+
+/**
+ * Operation stream decoded from the fuzzer input, reading zeros once it is consumed.
+ */
+class FuzzInput {
+public:
+    /**
+     * @param data start of the input.
+     * @param size number of bytes of the input.
+     */
+    FuzzInput(const std::uint8_t *data, std::size_t size): data{data}, size{size} {}
+
+    /**
+     * @return true if every byte was consumed.
+     */
+    [[nodiscard]] bool done() const {
+        return position == size;
+    }
+
+    /**
+     * @return the next byte, 0 past the end of the input.
+     */
+    std::uint8_t byte() {
+        return done() ? 0 : data[position++];
+    }
+
+    /**
+     * @return the next key, in [0, fuzz_key_range).
+     */
+    int key() {
+        return byte() % fuzz_key_range;
+    }
+
+    /**
+     * @param limit largest number of keys.
+     * @return up to limit keys, in the order of the input & possibly repeated.
+     */
+    std::vector<int> keys(std::size_t limit) {
+        std::vector<int> result(byte() % (limit + 1));
+
+        for (auto& key: result) {
+            key = this->key();
+        }
+
+        return result;
+    }
+private:
+    const std::uint8_t *data;
+    std::size_t size;
+    std::size_t position{0};
+};
+
+/**
+ * @param tree to be checked.
+ * @param oracle set holding the keys the tree should hold.
+ */
+template <typename Tree>
+void fuzzCompare(const Tree& tree, const std::set<int>& oracle) {
+    fuzzCheck(tree.validate(), "validate() failed");
+    fuzzCheck(tree.size() == static_cast<typename Tree::size_type>(oracle.size()), "size() differs");
+    fuzzCheck(tree.empty() == oracle.empty(), "empty() differs");
+    fuzzCheck(std::equal(tree.begin(), tree.end(), oracle.begin(), oracle.end()), "in-order traversal differs");
+    fuzzCheck(std::equal(tree.rbegin(), tree.rend(), oracle.rbegin(), oracle.rend()), "reverse traversal differs");
+}
+
+/**
+ * @param tree searched for the position.
+ * @param oracle set holding the same keys.
+ * @param position iterator of the tree.
+ * @param expected iterator of the oracle it should match.
+ * @param what description of the check.
+ */
+template <typename Tree, typename Iterator>
+void fuzzCompareMatch(const Tree& tree, const std::set<int>& oracle, Iterator position,
+                      std::set<int>::const_iterator expected, const char *what) {
+    fuzzCheck((position == tree.end()) == (expected == oracle.end()), what);
+    fuzzCheck(position == tree.end() or *position == *expected, what);
+}
+
+/**
+ * @tparam Error type of the exception expected.
+ * @param action expected to throw an Error.
+ * @param what description of the check.
+ */
+template <typename Error = std::runtime_error, typename Action>
+void fuzzThrows(Action&& action, const char *what) {
+    try {
+        action();
+    } catch (const Error&) {
+        return;
+    }
+
+    fuzzCheck(false, what);
+}
+
+/**
+ * @param lookup read-only tree, such as MappedAVL or FrozenAVL, answering with key pointers.
+ * @param oracle set holding the keys the tree should hold, converted to its key type.
+ */
+template <typename Lookup>
+void fuzzCompareLookups(const Lookup& lookup, const std::set<int>& oracle) {
+    using Key = std::decay_t<decltype(*lookup.lower_bound({}))>;
+    std::vector<Key> keys;
+    lookup.for_each([&](const Key& key) { keys.push_back(key); });
+
+    fuzzCheck(std::equal(keys.begin(), keys.end(), oracle.begin(), oracle.end()), "lookup traversal differs");
+    fuzzCheck(lookup.size() == static_cast<decltype(lookup.size())>(oracle.size()), "lookup size() differs");
+
+    for (int key{-1}; key <= fuzz_key_range; ++key) {
+        const auto lower{oracle.lower_bound(key)};
+        const auto upper{oracle.upper_bound(key)};
+        const Key *found{lookup.lower_bound(static_cast<Key>(key))};
+
+        fuzzCheck(lookup.contains(static_cast<Key>(key)) == (oracle.count(key) == 1), "lookup contains() differs");
+        fuzzCheck(found ? lower != oracle.end() and *found == *lower : lower == oracle.end(),
+                  "lookup lower_bound() differs");
+        found = lookup.upper_bound(static_cast<Key>(key));
+        fuzzCheck(found ? upper != oracle.end() and *found == *upper : upper == oracle.end(),
+                  "lookup upper_bound() differs");
+    }
+}
+
+/**
+ * Saves the tree as an image, to a stream & optionally to a file, maps it back & compares its lookups,
+ * then checks that truncated & misaligned copies are rejected.
+ *
+ * @param tree to be saved.
+ * @param oracle set holding the same keys.
+ * @param to_file true to round-trip through save(path) & a mapped file as well.
+ */
+template <typename Tree>
+void fuzzImage(const Tree& tree, const std::set<int>& oracle, bool to_file) {
+    std::ostringstream out;
+    tree.save(out);
+    const std::string image{out.str()};
+
+    // one spare byte to shift the image off its alignment
+    std::vector<std::max_align_t> storage(image.size() / sizeof(std::max_align_t) + 2);
+    auto *bytes{reinterpret_cast<char*>(storage.data())};
+    std::memcpy(bytes, image.data(), image.size());
+
+    fuzzCompareLookups(MappedAVL<int>(bytes, image.size()), oracle);
+    fuzzThrows([&] { MappedAVL<int>(bytes, sizeof(AvlImageHeader) - 1); }, "truncated header accepted");
+
+    if (not oracle.empty()) {
+        fuzzThrows([&] { MappedAVL<int>(bytes, image.size() - 1); }, "truncated keys accepted");
+    }
+
+    std::memmove(bytes + 1, bytes, image.size());
+    fuzzThrows([&] { MappedAVL<int>(bytes + 1, image.size()); }, "misaligned image accepted");
+
+    if (to_file) {
+        const auto path{std::filesystem::temp_directory_path() /
+                        ("avl_fuzz_" + std::to_string(std::random_device()()) + ".image")};
+        tree.save(path.string());
+
+        {
+            const MappedAVL<int> mapped(path.string());
+            fuzzCompareLookups(mapped, oracle);
+        }
+
+        std::ifstream in{path, std::ios::binary};
+        const std::string written{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        std::filesystem::remove(path);
+
+        fuzzCheck(written == image, "save(path) & save(stream) images differ");
+    }
+}
+
+/**
+ * @param first start of the keys.
+ * @param last end of the keys.
+ * @return set holding the keys.
+ */
+template <typename InputIt>
+std::set<int> fuzzSetOf(InputIt first, InputIt last) {
+    return std::set<int>(first, last);
+}
+
+/**
+ * Runs the operations of the input on one configuration of the tree.
+ *
+ * @tparam NodePolicy layout of the nodes of the tree.
+ * @param input operation stream.
+ * @param alloc shared by every tree, so they can be joined & merged.
+ */
+template <typename NodePolicy, typename Allocator>
+void fuzzTree(FuzzInput& input, const Allocator& alloc) {
+    using Tree = AVL<int, std::less<int>, Allocator, NodePolicy>;
+    constexpr bool counted{not std::is_void_v<typename NodePolicy::subtree_size_type>};
+
+    Tree tree(std::less<int>(), alloc);
+    std::set<int> oracle;
+
+    while (not input.done()) {
+        const std::uint8_t operation{input.byte()};
+        const int key{input.key()};
+
+        switch (operation % 18) {
+            case 0: {
+                const auto [position, inserted] = tree.insert(key);
+                fuzzCheck(inserted == oracle.insert(key).second, "insert() result differs");
+                fuzzCheck(*position == key, "insert() position differs");
+                break;
+            }
+            case 1: {
+                fuzzCheck(tree.remove(key) == (oracle.erase(key) == 1), "remove() result differs");
+                break;
+            }
+            case 2: {
+                const auto *node{tree.search(key)};
+                fuzzCheck((node != nullptr) == (oracle.count(key) == 1), "search() result differs");
+                fuzzCheck(not node or node->key == key, "search() key differs");
+                break;
+            }
+            case 3: {
+                fuzzCompareMatch(tree, oracle, tree.lower_bound(key), oracle.lower_bound(key), "lower_bound() differs");
+                fuzzCompareMatch(tree, oracle, tree.upper_bound(key), oracle.upper_bound(key), "upper_bound() differs");
+                break;
+            }
+            case 4: {
+                // hinted insertion, the hint being drawn from the current keys
+                const auto hint{tree.lower_bound(input.key())};
+                const auto position{tree.insert(hint, key)};
+                oracle.insert(key);
+                fuzzCheck(*position == key, "hinted insert() position differs");
+                break;
+            }
+            case 5: {
+                auto keys{input.keys(32)};
+                std::sort(keys.begin(), keys.end());
+                keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+                tree = Tree::build_from_sorted(keys.begin(), keys.end(), std::less<int>(), alloc);
+                oracle = fuzzSetOf(keys.begin(), keys.end());
+                break;
+            }
+            case 6: {
+                auto right{tree.split(key)};
+                const auto pivot{oracle.lower_bound(key)};
+                const auto right_oracle{fuzzSetOf(pivot, oracle.cend())};
+                oracle.erase(pivot, oracle.end());
+                fuzzCompare(tree, oracle);
+                fuzzCompare(right, right_oracle);
+
+                if (input.byte() % 2 and not right_oracle.empty() and *right_oracle.begin() == key) {
+                    // joins around the split key as a pivot
+                    right.remove(key);
+                    tree = Tree::join(std::move(tree), key, std::move(right));
+                } else {
+                    tree = Tree::join(std::move(tree), std::move(right));
+                }
+
+                fuzzCheck(right.empty(), "join() left keys in its argument");
+                oracle.insert(right_oracle.begin(), right_oracle.end());
+                break;
+            }
+            case 7:
+            case 8:
+            case 9: {
+                const auto keys{input.keys(32)};
+                Tree other(std::less<int>(), alloc);
+
+                for (const int other_key: keys) {
+                    other.insert(other_key);
+                }
+
+                const auto other_oracle{fuzzSetOf(keys.begin(), keys.end())};
+                fuzzCompare(other, other_oracle);
+                std::set<int> expected;
+
+                if (operation % 18 == 7) {
+                    tree.set_union(std::move(other));
+                    std::set_union(oracle.begin(), oracle.end(), other_oracle.begin(), other_oracle.end(),
+                                   std::inserter(expected, expected.end()));
+                } else if (operation % 18 == 8) {
+                    tree.set_intersection(std::move(other));
+                    std::set_intersection(oracle.begin(), oracle.end(), other_oracle.begin(), other_oracle.end(),
+                                          std::inserter(expected, expected.end()));
+                } else {
+                    tree.set_difference(std::move(other));
+                    std::set_difference(oracle.begin(), oracle.end(), other_oracle.begin(), other_oracle.end(),
+                                        std::inserter(expected, expected.end()));
+                }
+
+                oracle = std::move(expected);
+                break;
+            }
+            case 10: {
+                auto batch{input.keys(32)};
+                std::size_t expected{0};
+
+                for (const int batch_key: batch) {
+                    expected += oracle.insert(batch_key).second;
+                }
+
+                const auto inserted{tree.insert_batch(batch.begin(), batch.end())};
+                fuzzCheck(inserted == static_cast<decltype(inserted)>(expected), "insert_batch() result differs");
+                break;
+            }
+            case 11: {
+                auto batch{input.keys(32)};
+                std::size_t expected{0};
+
+                for (const int batch_key: batch) {
+                    expected += oracle.erase(batch_key);
+                }
+
+                const auto removed{tree.erase_batch(batch.begin(), batch.end())};
+                fuzzCheck(removed == static_cast<decltype(removed)>(expected), "erase_batch() result differs");
+                break;
+            }
+            case 12: {
+                // walks a few steps forward & backward from a bound, along with a set iterator
+                auto position{tree.lower_bound(key)};
+                auto expected{oracle.lower_bound(key)};
+                const std::uint8_t steps{input.byte()};
+
+                for (std::uint8_t step{0}; step < steps % 8 and expected != oracle.end(); ++step) {
+                    ++position;
+                    ++expected;
+                    fuzzCompareMatch(tree, oracle, position, expected, "iterator increment differs");
+                }
+
+                for (std::uint8_t step{0}; step < steps / 32 and expected != oracle.begin(); ++step) {
+                    --position;
+                    --expected;
+                    fuzzCompareMatch(tree, oracle, position, expected, "iterator decrement differs");
+                }
+
+                fuzzCompareMatch(tree, oracle, tree.search_from(position, key), oracle.find(key), "search_from() differs");
+                break;
+            }
+            case 13: {
+                const int high{input.key()};
+                const auto view{tree.range(std::min(key, high), std::max(key, high))};
+                const auto first{oracle.lower_bound(std::min(key, high))};
+                const auto last{oracle.upper_bound(std::max(key, high))};
+                fuzzCheck(std::equal(view.begin(), view.end(), first, last), "range() differs");
+                fuzzCheck(view.empty() == (first == last), "range() emptiness differs");
+                break;
+            }
+            case 14: {
+                // by key, or by the position of the first key not before it
+                const auto position{tree.lower_bound(key)};
+                const bool by_position{input.byte() % 2 and position != tree.end()};
+                const int extracted{by_position ? *position : key};
+
+                auto handle{by_position ? tree.extract(position) : tree.extract(key)};
+                fuzzCheck(handle.empty() == (oracle.erase(extracted) == 0), "extract() result differs");
+                fuzzCompare(tree, oracle);
+
+                if (not handle.empty()) {
+                    fuzzCheck(handle.value() == extracted, "extract() key differs");
+                    fuzzCheck(tree.insert(std::move(handle)).inserted, "reinserting the extracted node failed");
+                    oracle.insert(extracted);
+                }
+
+                break;
+            }
+            case 15: {
+                fuzzImage(tree, oracle, key % 32 == 0);
+                break;
+            }
+            case 16: {
+                // blocks of 16, 32 & 8 keys, searched with SIMD where enabled, & the Eytzinger fallback
+                fuzzCompareLookups(tree.freeze(), oracle);
+                const std::vector<std::int16_t> narrow(oracle.begin(), oracle.end());
+                fuzzCompareLookups(FrozenAVL<std::int16_t>(narrow.begin(), narrow.size()), oracle);
+                const std::vector<long long> wide(oracle.begin(), oracle.end());
+                fuzzCompareLookups(FrozenAVL<long long>(wide.begin(), wide.size()), oracle);
+                fuzzCompareLookups(FrozenAVL<int, std::less<>>(oracle.begin(), oracle.size()), oracle);
+                break;
+            }
+            default: {
+                if constexpr (counted) {
+                    fuzzCheck(tree.rank(key) == static_cast<typename Tree::size_type>(
+                        std::distance(oracle.begin(), oracle.lower_bound(key))), "rank() differs");
+
+                    const auto index{static_cast<typename Tree::size_type>(input.byte()) % (tree.size() + 1)};
+                    fuzzCompareMatch(tree, oracle, tree.select(index),
+                                     std::next(oracle.begin(), static_cast<std::ptrdiff_t>(index)), "select() differs");
+                } else {
+                    // copies the tree, & keeps going with the copy
+                    Tree copy(tree);
+                    fuzzCompare(copy, oracle);
+                    tree.clear();
+                    fuzzCompare(tree, {});
+                    tree = std::move(copy);
+                }
+
+                break;
+            }
+        }
+
+        fuzzCompare(tree, oracle);
+    }
+}
+
+/**
+ * Builds large trees with the parallel operations & merges them, against std::set.
+ * Past 2^12 keys the trees are taller than the cutoff height, so the operations do fork,
+ * which makes every round costly: only the first ones of the input are run.
+ *
+ * @tparam NodePolicy layout of the nodes of the trees.
+ * @param input operation stream, seeding the keys.
+ * @param alloc shared by every tree, so they can be merged.
+ */
+template <typename NodePolicy, typename Allocator>
+void fuzzParallel(FuzzInput& input, const Allocator& alloc) {
+    using Tree = AVL<int, std::less<int>, Allocator, NodePolicy>;
+    static WorkStealingPool pool(2);
+
+    for (int round{0}; round < 2 and not input.done(); round++) {
+        const std::uint8_t operation{input.byte()};
+        const auto count{std::size_t{4096} + std::size_t{input.byte()} * 8};
+        std::mt19937 random{input.byte() | static_cast<unsigned>(input.byte()) << 8};
+
+        // the density of the keys decides how much the trees overlap
+        std::uniform_int_distribution<int> pick(0, static_cast<int>(count) * (1 + operation / 3 % 4));
+        std::set<int> oracle;
+        std::set<int> other_oracle;
+
+        while (oracle.size() < count) {
+            oracle.insert(pick(random));
+        }
+
+        while (other_oracle.size() < count) {
+            other_oracle.insert(pick(random));
+        }
+
+        const std::vector<int> keys(oracle.begin(), oracle.end());
+        const std::vector<int> other_keys(other_oracle.begin(), other_oracle.end());
+        auto tree{Tree::build_from_sorted(keys.begin(), keys.end(), pool, std::less<int>(), alloc)};
+        auto other{Tree::build_from_sorted(other_keys.begin(), other_keys.end(), pool, std::less<int>(), alloc)};
+        fuzzCompare(tree, oracle);
+        fuzzCompare(other, other_oracle);
+        std::set<int> expected;
+
+        if (operation % 3 == 0) {
+            tree.set_union(std::move(other), pool);
+            std::set_union(oracle.begin(), oracle.end(), other_oracle.begin(), other_oracle.end(),
+                           std::inserter(expected, expected.end()));
+        } else if (operation % 3 == 1) {
+            tree.set_intersection(std::move(other), pool);
+            std::set_intersection(oracle.begin(), oracle.end(), other_oracle.begin(), other_oracle.end(),
+                                  std::inserter(expected, expected.end()));
+        } else {
+            tree.set_difference(std::move(other), pool);
+            std::set_difference(oracle.begin(), oracle.end(), other_oracle.begin(), other_oracle.end(),
+                                std::inserter(expected, expected.end()));
+        }
+
+        fuzzCompare(tree, expected);
+    }
+}
+
+/**
+ * Runs the operations of the input on an AVLMap, against std::map.
+ *
+ * @tparam NodePolicy layout of the nodes of the map.
+ * @param input operation stream.
+ */
+template <typename NodePolicy>
+void fuzzMap(FuzzInput& input) {
+    using Map = AVLMap<int, int, std::less<int>, std::allocator<std::pair<const int, int>>, NodePolicy>;
+
+    Map map;
+    std::map<int, int> oracle;
+
+    while (not input.done()) {
+        const std::uint8_t operation{input.byte()};
+        const int key{input.key()};
+        const int value{input.byte()};
+
+        switch (operation % 9) {
+            case 0: {
+                const auto [position, inserted] = map.try_emplace(key, value);
+                fuzzCheck(inserted == oracle.try_emplace(key, value).second, "try_emplace() result differs");
+                fuzzCheck(position->first == key and position->second == oracle[key], "try_emplace() position differs");
+                break;
+            }
+            case 1: {
+                const auto [position, inserted] = map.insert_or_assign(key, value);
+                fuzzCheck(inserted == oracle.insert_or_assign(key, value).second, "insert_or_assign() result differs");
+                fuzzCheck(position->second == value, "insert_or_assign() value differs");
+                break;
+            }
+            case 2: {
+                map[key] += value;
+                oracle[key] += value;
+                break;
+            }
+            case 3: {
+                const auto expected{oracle.find(key)};
+
+                if (expected == oracle.end()) {
+                    fuzzThrows<std::out_of_range>([&] { (void) map.at(key); }, "at() of an absent key returned");
+                } else {
+                    fuzzCheck(map.at(key) == expected->second, "at() differs");
+                }
+
+                break;
+            }
+            case 4: {
+                fuzzCheck(map.erase(key) == static_cast<typename Map::size_type>(oracle.erase(key)),
+                          "erase() result differs");
+                break;
+            }
+            case 5: {
+                // erases the first pair not before the key, & checks the one following it
+                const auto position{map.lower_bound(key)};
+                const auto expected{oracle.lower_bound(key)};
+                fuzzCheck((position == map.end()) == (expected == oracle.end()), "lower_bound() differs");
+
+                if (expected != oracle.end()) {
+                    const auto next{map.erase(position)};
+                    const auto expected_next{oracle.erase(expected)};
+                    fuzzCheck((next == map.end()) == (expected_next == oracle.end()), "erase() position differs");
+                    fuzzCheck(next == map.end() or next->first == expected_next->first, "erase() position differs");
+                }
+
+                break;
+            }
+            case 6: {
+                // adds the value, erasing the pair once it crosses 255
+                const bool found{map.update_or_erase(key, [&](int& mapped) { return (mapped += value) > 255; })};
+                const auto expected{oracle.find(key)};
+                fuzzCheck(found == (expected != oracle.end()), "update_or_erase() result differs");
+
+                if (found and (expected->second += value) > 255) {
+                    oracle.erase(expected);
+                }
+
+                break;
+            }
+            case 7: {
+                auto handle{map.extract(key)};
+                const auto expected{oracle.extract(key)};
+                fuzzCheck(handle.empty() == expected.empty(), "extract() result differs");
+                fuzzCheck(handle.empty() or handle.value().second == expected.mapped(), "extract() value differs");
+                break;
+            }
+            default: {
+                const auto found{map.find(key)};
+                const auto expected{oracle.find(key)};
+                fuzzCheck(map.contains(key) == (expected != oracle.end()), "contains() differs");
+                fuzzCheck((found == map.end()) == (expected == oracle.end()), "find() differs");
+
+                const auto upper{map.upper_bound(key)};
+                const auto expected_upper{oracle.upper_bound(key)};
+                fuzzCheck((upper == map.end()) == (expected_upper == oracle.end()), "upper_bound() differs");
+                fuzzCheck(upper == map.end() or upper->first == expected_upper->first, "upper_bound() differs");
+                break;
+            }
+        }
+
+        fuzzCheck(map.base().validate(), "map invariants broken");
+        fuzzCheck(map.size() == static_cast<typename Map::size_type>(oracle.size()), "map size() differs");
+        fuzzCheck(std::equal(map.begin(), map.end(), oracle.begin(), oracle.end(),
+                             [](const auto& lhs, const auto& rhs) {
+                                 return lhs.first == rhs.first and lhs.second == rhs.second;
+                             }), "map traversal differs");
+    }
+}
+
+/**
+ * Runs the operations of the input on an AVLMultiset, against std::multiset.
+ *
+ * @tparam NodePolicy layout of the nodes of the multiset.
+ * @param input operation stream.
+ */
+template <typename NodePolicy>
+void fuzzMultiset(FuzzInput& input) {
+    using Multiset = AVLMultiset<int, std::less<int>, std::allocator<int>, NodePolicy>;
+    using size_type = typename Multiset::size_type;
+
+    Multiset multiset;
+    std::multiset<int> oracle;
+
+    while (not input.done()) {
+        const std::uint8_t operation{input.byte()};
+        const int key{input.key()};
+
+        switch (operation % 5) {
+            case 0: {
+                // zero occurrences must be rejected, leaving the multiset untouched
+                const size_type occurrences{operation / 5 % 4};
+
+                if (occurrences < 1) {
+                    fuzzThrows<std::invalid_argument>([&] { multiset.insert(key, occurrences); },
+                                                      "insert() of no occurrence accepted");
+                } else {
+                    for (size_type i{0}; i < occurrences; i++) {
+                        oracle.insert(key);
+                    }
+
+                    fuzzCheck(multiset.insert(key, occurrences) == static_cast<size_type>(oracle.count(key)),
+                              "insert() count differs");
+                }
+
+                break;
+            }
+            case 1: {
+                const auto expected{oracle.find(key)};
+                fuzzCheck(multiset.erase_one(key) == (expected != oracle.end()), "erase_one() result differs");
+
+                if (expected != oracle.end()) {
+                    oracle.erase(expected);
+                }
+
+                break;
+            }
+            case 2: {
+                fuzzCheck(multiset.erase(key) == static_cast<size_type>(oracle.erase(key)), "erase() result differs");
+                break;
+            }
+            case 3: {
+                const auto lower{multiset.lower_bound(key)};
+                const auto upper{multiset.upper_bound(key)};
+                const auto expected_lower{oracle.lower_bound(key)};
+                const auto expected_upper{oracle.upper_bound(key)};
+                fuzzCheck((lower == multiset.end()) == (expected_lower == oracle.end()), "lower_bound() differs");
+                fuzzCheck(lower == multiset.end() or lower->first == *expected_lower, "lower_bound() differs");
+                fuzzCheck((upper == multiset.end()) == (expected_upper == oracle.end()), "upper_bound() differs");
+                fuzzCheck(upper == multiset.end() or upper->first == *expected_upper, "upper_bound() differs");
+                break;
+            }
+            default: {
+                const auto found{multiset.find(key)};
+                const auto count{static_cast<size_type>(oracle.count(key))};
+                fuzzCheck(multiset.count(key) == count, "count() differs");
+                fuzzCheck(multiset.contains(key) == (count > 0), "contains() differs");
+                fuzzCheck(count ? found != multiset.end() and found->second == count : found == multiset.end(),
+                          "find() differs");
+                break;
+            }
+        }
+
+        // expands the (key, count) pairs back into the sequence of the oracle
+        std::vector<int> keys;
+
+        for (const auto& [stored, occurrences]: multiset) {
+            keys.insert(keys.end(), static_cast<std::size_t>(occurrences), stored);
+        }
+
+        fuzzCheck(multiset.base().base().validate(), "multiset invariants broken");
+        fuzzCheck(std::equal(keys.begin(), keys.end(), oracle.begin(), oracle.end()), "multiset traversal differs");
+        fuzzCheck(multiset.size() == static_cast<size_type>(oracle.size()), "multiset size() differs");
+        fuzzCheck(multiset.distinct() == multiset.base().size(), "multiset distinct() differs");
+        fuzzCheck(multiset.empty() == oracle.empty(), "multiset empty() differs");
+    }
+}
+
+/**
+ * Runs the operations of the input on a hashed & a range-partitioned ShardedAVL, against std::set.
+ * Both are driven from one thread, AvlStress.cpp covers the concurrent writers.
+ *
+ * @param input operation stream, starting with the shard counts & the splitters.
+ */
+inline void fuzzSharded(FuzzInput& input) {
+    std::vector<int> splitters{input.keys(8)};
+    std::sort(splitters.begin(), splitters.end());
+    splitters.erase(std::unique(splitters.begin(), splitters.end()), splitters.end());
+
+    ShardedAVL<int, HashPartition<int>, std::less<int>, PoolAllocator<int>> hashed{
+        HashPartition<int>(std::size_t{1} + input.byte() % 8)};
+    ShardedAVL<int, RangePartition<int>> ranged{RangePartition<int>(splitters)};
+    std::set<int> oracle;
+
+    // checks both trees the same way
+    auto compare = [&](const auto& sharded) {
+        std::vector<int> keys;
+        sharded.for_each([&](int key) { keys.push_back(key); });
+        fuzzCheck(std::equal(keys.begin(), keys.end(), oracle.begin(), oracle.end()), "sharded traversal differs");
+        fuzzCheck(sharded.size() == static_cast<decltype(sharded.size())>(oracle.size()), "sharded size() differs");
+    };
+
+    while (not input.done()) {
+        const std::uint8_t operation{input.byte()};
+        const int key{input.key()};
+
+        switch (operation % 5) {
+            case 0: {
+                const bool inserted{oracle.insert(key).second};
+                fuzzCheck(hashed.insert(key) == inserted, "hashed insert() result differs");
+                fuzzCheck(ranged.insert(key) == inserted, "ranged insert() result differs");
+                break;
+            }
+            case 1: {
+                const bool removed{oracle.erase(key) == 1};
+                fuzzCheck(hashed.remove(key) == removed, "hashed remove() result differs");
+                fuzzCheck(ranged.remove(key) == removed, "ranged remove() result differs");
+                break;
+            }
+            case 2: {
+                const bool present{oracle.count(key) == 1};
+                fuzzCheck(hashed.contains(key) == present and ranged.contains(key) == present, "contains() differs");
+                fuzzCheck(hashed.find(key).has_value() == present and ranged.find(key) == hashed.find(key),
+                          "find() differs");
+                break;
+            }
+            case 3: {
+                const auto lower{oracle.lower_bound(key)};
+                const auto expected{lower == oracle.end() ? std::nullopt : std::optional<int>(*lower)};
+                fuzzCheck(hashed.lower_bound(key) == expected, "hashed lower_bound() differs");
+                fuzzCheck(ranged.lower_bound(key) == expected, "ranged lower_bound() differs");
+                break;
+            }
+            default: {
+                const int high{input.key()};
+                std::vector<int> expected;
+
+                if (key <= high) {
+                    expected.assign(oracle.lower_bound(key), oracle.upper_bound(high));
+                }
+
+                std::vector<int> keys;
+                hashed.for_each_in_range(key, high, [&](int stored) { keys.push_back(stored); });
+                fuzzCheck(keys == expected, "hashed for_each_in_range() differs");
+                keys.clear();
+                ranged.for_each_in_range(key, high, [&](int stored) { keys.push_back(stored); });
+                fuzzCheck(keys == expected, "ranged for_each_in_range() differs");
+                break;
+            }
+        }
+
+        compare(hashed);
+        compare(ranged);
+    }
+}
+
+/**
+ * Runs the operations of the input on an IntervalTree, against a brute force scan of the intervals.
+ *
+ * @param input operation stream.
+ */
+inline void fuzzInterval(FuzzInput& input) {
+    IntervalTree<int> tree;
+    std::set<Interval<int>> oracle;
+
+    while (not input.done()) {
+        const std::uint8_t operation{input.byte()};
+        const int first{input.key()};
+        const int second{input.key()};
+        const Interval<int> interval{std::min(first, second), std::max(first, second)};
+
+        // every stored interval overlapping the query, in order
+        std::vector<Interval<int>> expected;
+        std::copy_if(oracle.begin(), oracle.end(), std::back_inserter(expected),
+                     [&](const Interval<int>& stored) { return stored.overlaps(interval); });
+
+        switch (operation % 5) {
+            case 0:
+            case 1: {
+                fuzzCheck(tree.insert(interval).second == oracle.insert(interval).second, "insert() result differs");
+                break;
+            }
+            case 2: {
+                fuzzCheck(tree.remove(interval) == (oracle.erase(interval) == 1), "remove() result differs");
+                break;
+            }
+            case 3: {
+                fuzzCheck(tree.overlapping(interval) == expected, "overlapping() differs");
+                fuzzCheck(tree.any_overlapping(interval) == not expected.empty(), "any_overlapping() differs");
+                break;
+            }
+            default: {
+                expected.clear();
+                std::copy_if(oracle.begin(), oracle.end(), std::back_inserter(expected),
+                             [&](const Interval<int>& stored) { return stored.low <= first and first <= stored.high; });
+                fuzzCheck(tree.stabbing(first) == expected, "stabbing() differs");
+                break;
+            }
+        }
+
+        fuzzCheck(tree.validate(), "interval tree invariants broken");
+        fuzzCheck(std::equal(tree.begin(), tree.end(), oracle.begin(), oracle.end()), "interval traversal differs");
+    }
+}
+
+/**
+ * Inserts the keys of the input into a StaticAVL at run time, against std::set.
+ * The capacity covers every key, so no insertion may fail.
+ *
+ * @param input operation stream.
+ */
+inline void fuzzStatic(FuzzInput& input) {
+    StaticAVL<int, fuzz_key_range> tree;
+    std::set<int> oracle;
+
+    while (not input.done()) {
+        const int key{input.key()};
+        fuzzCheck(tree.insert(key) == oracle.insert(key).second, "static insert() result differs");
+        fuzzCheck(tree.contains(key), "static contains() differs");
+    }
+
+    std::vector<int> keys;
+    tree.for_each([&](int key) { keys.push_back(key); });
+    fuzzCheck(std::equal(keys.begin(), keys.end(), oracle.begin(), oracle.end()), "static traversal differs");
+    fuzzCompareLookups(tree, oracle);
+
+    // an AVL tree of n keys is at most 1.44 log2(n + 2) high
+    fuzzCheck(tree.height() <= 1.45 * std::log2(static_cast<double>(oracle.size()) + 2), "static height() unbalanced");
+}
+
+/**
+ * The first byte picks the front-end, or the node policy & allocator of the tree, the others are the operations.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size) {
+    FuzzInput input{data, size};
+
+    switch (input.byte() % 12) {
+        case 0:
+            fuzzTree<DefaultNodePolicy>(input, std::allocator<int>());
+            break;
+        case 1:
+            fuzzTree<ParentNodePolicy>(input, std::allocator<int>());
+            break;
+        case 2:
+            fuzzTree<OrderStatisticNodePolicy>(input, std::allocator<int>());
+            break;
+        case 3:
+            fuzzTree<CompactParentNodePolicy>(input, PoolAllocator<int>());
+            break;
+        case 4:
+            fuzzTree<CompactOrderStatisticNodePolicy>(input, PoolAllocator<int>());
+            break;
+        case 5:
+            fuzzParallel<DefaultNodePolicy>(input, std::allocator<int>());
+            break;
+        case 6:
+            fuzzParallel<CompactOrderStatisticNodePolicy>(input, PoolAllocator<int>());
+            break;
+        case 7:
+            fuzzMap<ParentNodePolicy>(input);
+            break;
+        case 8:
+            fuzzMultiset<OrderStatisticNodePolicy>(input);
+            break;
+        case 9:
+            fuzzSharded(input);
+            break;
+        case 10:
+            fuzzInterval(input);
+            break;
+        default:
+            fuzzStatic(input);
+            break;
+    }
+
+    return 0;
+}
+
+#if AVL_FUZZ_STANDALONE
+/**
+ * Randomized loop without libFuzzer, feeding random inputs to LLVMFuzzerTestOneInput().
+ * Usage: avl_fuzz [runs [seed]], a failing run reports its seed & index to replay it.
+ */
+int main(int argc, char **argv) {
+    const auto runs{argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000};
+    const auto seed{argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::random_device()()};
+    std::vector<std::uint8_t> data;
+
+    std::fprintf(stderr, "avl_fuzz: %llu runs, seed %llu\n", runs, static_cast<unsigned long long>(seed));
+
+    for (unsigned long long run{0}; run < runs; ++run) {
+        // each run is reproducible on its own from the seed & its index
+        std::mt19937_64 random{seed ^ (run * 0x9e3779b97f4a7c15ULL)};
+        data.resize(random() % 4096);
+
+        for (auto& byte: data) {
+            byte = static_cast<std::uint8_t>(random());
+        }
+
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+
+    return 0;
+}
+#endif
@@ -0,0 +1,278 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Eytzinger.cpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define AVL_HAS_MMAP 1
+#else
+#define AVL_HAS_MMAP 0
+#endif
+
+
+/**
+ * Binary image of a tree of trivially copyable keys: a header, then the keys in Eytzinger order,
+ * aligned to a cache line. The layout is implicit, so the image holds no link at all.
+ * Keys are stored in the native byte order & representation.
+ */
+struct AvlImageHeader {
+    // Identifies the format, "AVLIMG" followed by zeros.
+    char magic[8];
+
+    // Format version, 1.
+    std::uint32_t version;
+
+    // Size & alignment of one key.
+    std::uint32_t key_size;
+    std::uint32_t key_align;
+
+    // Padding, zero.
+    std::uint32_t reserved;
+
+    // Number of keys.
+    std::uint64_t count;
+
+    // Offset of the first key from the start of the image.
+    std::uint64_t keys_offset;
+
+    static constexpr char expected_magic[8]{'A', 'V', 'L', 'I', 'M', 'G', '\0', '\0'};
+    static constexpr std::uint32_t current_version{1};
+};
+
+/**
+ * @tparam T type of the keys.
+ * @return offset of the keys in an image, past the header & aligned.
+ */
+template <typename T>
+constexpr std::uint64_t avlImageKeysOffset() {
+    constexpr std::uint64_t alignment{alignof(T) < 64 ? 64 : alignof(T)};
+    return (sizeof(AvlImageHeader) + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @tparam T type of the keys.
+ * @param count number of keys.
+ * @return header of an image of count keys.
+ */
+template <typename T>
+AvlImageHeader avlImageHeader(std::size_t count) {
+    AvlImageHeader header{};
+    std::memcpy(header.magic, AvlImageHeader::expected_magic, sizeof(header.magic));
+    header.version = AvlImageHeader::current_version;
+    header.key_size = sizeof(T);
+    header.key_align = alignof(T);
+    header.count = count;
+    header.keys_offset = avlImageKeysOffset<T>();
+    return header;
+}
+
+/**
+ * Streams the keys in Eytzinger order through a fixed 16 KiB buffer, without copying them all.
+ * The top levels fit in the buffer & are gathered in one pass over the keys, every deeper level
+ * takes one more pass: about log2(count * sizeof(T) / 16 KiB) + 1 passes, 9 for a million ints.
+ * Prefer writeAvlImageFile() for files, which makes a single pass.
+ *
+ * @param out binary stream the image is written to.
+ * @param first start of the keys, sorted & without duplicates.
+ * @param count number of keys.
+ * @throws runtime_error if the stream fails.
+ */
+template <typename T, typename ForwardIt>
+void writeAvlImage(std::ostream& out, ForwardIt first, std::size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>, "tree images need trivially copyable keys");
+
+    const AvlImageHeader header{avlImageHeader<T>(count)};
+    const std::vector<char> padding(header.keys_offset - sizeof(header), 0);
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+    // keys are copied byte-wise, so T needs no default constructor
+    char chunk[16384];
+    constexpr std::size_t capacity{sizeof(chunk) / sizeof(T)};
+    std::size_t used{0};
+
+    // the top levels fit in the chunk & are gathered in a single pass
+    std::size_t top{0};
+
+    while (top < 8 * sizeof(std::size_t) - 1 and (std::size_t{1} << (top + 1)) - 1 <= capacity and
+           std::size_t{1} << top <= count) {
+        ++top;
+    }
+
+    if (top) {
+        ForwardIt key{first};
+        auto gather{[&](std::size_t k, const T& value) {
+            std::memcpy(chunk + (k - 1) * sizeof(T), std::addressof(value), sizeof(T));
+        }};
+
+        eytzingerVisitLevels(key, count, 0, top - 1, gather);
+        used = std::min(count, (std::size_t{1} << top) - 1) * sizeof(T);
+    }
+
+    // each deeper level takes one more pass, streamed through the chunk
+    auto stream{[&](std::size_t, const T& value) {
+        if (used + sizeof(T) > sizeof(chunk)) {
+            out.write(chunk, static_cast<std::streamsize>(used));
+            used = 0;
+        }
+
+        if (sizeof(T) > sizeof(chunk)) {
+            out.write(reinterpret_cast<const char*>(std::addressof(value)), sizeof(T));
+        } else {
+            std::memcpy(chunk + used, std::addressof(value), sizeof(T));
+            used += sizeof(T);
+        }
+    }};
+
+    for (std::size_t depth{top}; depth < 8 * sizeof(std::size_t) and std::size_t{1} << depth <= count; ++depth) {
+        ForwardIt key{first};
+        eytzingerVisitLevels(key, count, depth, depth, stream);
+    }
+
+    out.write(chunk, static_cast<std::streamsize>(used));
+
+    if (not out) {
+        throw std::runtime_error("writeAvlImage: write failed");
+    }
+}
+
+/**
+ * Writes an image file in a single in-order pass over the keys, each one copied straight to its
+ * Eytzinger position inside the memory-mapped file. Falls back to writeAvlImage() without mmap.
+ *
+ * @param path of the image file, replaced if it exists.
+ * @param first start of the keys, sorted & without duplicates.
+ * @param count number of keys.
+ * @throws runtime_error if the file cannot be written.
+ */
+template <typename T, typename ForwardIt>
+void writeAvlImageFile(const std::string& path, ForwardIt first, std::size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>, "tree images need trivially copyable keys");
+
+#if AVL_HAS_MMAP
+    const AvlImageHeader header{avlImageHeader<T>(count)};
+    const auto bytes{static_cast<std::size_t>(header.keys_offset + count * sizeof(T))};
+    const int descriptor{::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)};
+
+    if (descriptor < 0) {
+        throw std::runtime_error("writeAvlImageFile: cannot open " + path);
+    }
+
+    // the file is grown with zeros, so the padding needs no write
+    void *address{::ftruncate(descriptor, static_cast<off_t>(bytes)) == 0 ?
+                  ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED};
+
+    if (address == MAP_FAILED) {
+        ::close(descriptor);
+        throw std::runtime_error("writeAvlImageFile: cannot map " + path);
+    }
+
+    auto *image{static_cast<unsigned char*>(address)};
+    std::memcpy(image, &header, sizeof(header));
+
+    // a walk that never stops at a level visits every node, in order
+    auto store{[keys = image + header.keys_offset](std::size_t k, const T& value) {
+        std::memcpy(keys + (k - 1) * sizeof(T), std::addressof(value), sizeof(T));
+    }};
+
+    eytzingerVisitLevels(first, count, 0, std::numeric_limits<std::size_t>::max(), store);
+
+    const bool unmapped{::munmap(address, bytes) == 0};
+
+    if (::close(descriptor) != 0 or not unmapped) {
+        throw std::runtime_error("writeAvlImageFile: cannot write " + path);
+    }
+#else
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+
+    if (not out) {
+        throw std::runtime_error("writeAvlImageFile: cannot open " + path);
+    }
+
+    writeAvlImage<T>(out, first, count);
+#endif
+}
+
+/**
+ * Validates the header of an image, without copying the keys.
+ *
+ * @param data start of the image, aligned to alignof(T) at least.
+ * @param bytes size of the image.
+ * @param count set to the number of keys.
+ * @return pointer to the keys inside the image.
+ * @throws runtime_error if the image is truncated or was written for another key type.
+ */
+template <typename T>
+const T* readAvlImage(const void *data, std::size_t bytes, std::size_t& count) {
+    static_assert(std::is_trivially_copyable_v<T>, "tree images need trivially copyable keys");
+
+    AvlImageHeader header;
+
+    if (bytes < sizeof(header)) {
+        throw std::runtime_error("readAvlImage: truncated header");
+    }
+
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, AvlImageHeader::expected_magic, sizeof(header.magic)) != 0 or
+        header.version != AvlImageHeader::current_version) {
+        throw std::runtime_error("readAvlImage: not a tree image");
+    }
+
+    if (header.key_size != sizeof(T) or header.key_align != alignof(T) or
+        header.keys_offset != avlImageKeysOffset<T>()) {
+        throw std::runtime_error("readAvlImage: image written for another key type");
+    }
+
+    if (bytes < header.keys_offset or (bytes - header.keys_offset) / sizeof(T) < header.count) {
+        throw std::runtime_error("readAvlImage: truncated keys");
+    }
+
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(T) != 0) {
+        throw std::runtime_error("readAvlImage: misaligned image");
+    }
+
+    count = static_cast<std::size_t>(header.count);
+    return reinterpret_cast<const T*>(static_cast<const unsigned char*>(data) + header.keys_offset);
+}
@@ -0,0 +1,517 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "AvlTree.cpp"
+
+
+/**
+ * Orders key/value pairs by their key only, & compares them with bare keys as well.
+ * Forwards three-way compare(a, b) to the key comparator when it has one.
+ *
+ * @tparam K type of the keys.
+ * @tparam V type of the mapped values.
+ * @tparam Compare strict weak ordering of the keys.
+ */
+template <typename K, typename V, typename Compare>
+struct MapKeyCompare {
+    using is_transparent = void;
+    using value_type = std::pair<const K, V>;
+
+    MapKeyCompare() = default;
+
+    /**
+     * @param comp ordering of the keys.
+     */
+    explicit MapKeyCompare(const Compare& comp): comparator{comp} {}
+
+    /**
+     * @return the key of the pair.
+     */
+    static const K& keyOf(const value_type& value) {
+        return value.first;
+    }
+
+    /**
+     * @return the key itself.
+     */
+    template <typename L>
+    static const L& keyOf(const L& key) {
+        return key;
+    }
+
+    /**
+     * @param a pair or key.
+     * @param b pair or key.
+     * @return true if the key of a comes before the key of b.
+     */
+    template <typename A, typename B>
+    bool operator()(const A& a, const B& b) const {
+        return comparator(keyOf(a), keyOf(b));
+    }
+
+    /**
+     * Only present if the key comparator has a three-way compare(a, b).
+     *
+     * @param a pair or key.
+     * @param b pair or key.
+     * @return negative if the key of a comes before the key of b, positive if after, 0 if equivalent.
+     */
+    template <typename A, typename B, typename C = Compare>
+    auto compare(const A& a, const B& b) const -> decltype(std::declval<const C&>().compare(keyOf(a), keyOf(b))) {
+        return comparator.compare(keyOf(a), keyOf(b));
+    }
+
+    /*
+     * Ordering of the keys.
+     */
+    Compare comparator{};
+};
+
+/**
+ * Ordered key/value map built on the AVL tree, each node holding one pair<const K, V>.
+ * Values can be modified in place through iterators, without any structural change,
+ * so the summaries of an augmented node policy should only depend on the keys.
+ *
+ * @tparam K type of the keys.
+ * @tparam V type of the mapped values.
+ * @tparam Compare strict weak ordering of the keys.
+ *                 A transparent comparator enables lookups by other key types.
+ * @tparam Allocator allocator of pair<const K, V>, rebound to allocate the nodes.
+ * @tparam NodePolicy layout of the nodes, see NodePolicy.cpp.
+ */
+template <
+    typename K,
+    typename V,
+    typename Compare = std::less<K>,
+    typename Allocator = std::allocator<std::pair<const K, V>>,
+    typename NodePolicy = DefaultNodePolicy
+>
+class AVLMap {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+
+    /* Tree holding the pairs */
+    using tree_type = AVL<value_type, MapKeyCompare<K, V, Compare>, Allocator, NodePolicy>;
+
+    using size_type = typename tree_type::size_type;
+    using const_iterator = typename tree_type::iterator;
+    using node_type = typename tree_type::node_type;
+
+    /**
+     * Bidirectional iterator over the pairs, in key order.
+     * Keys stay const, mapped values can be modified through it.
+     */
+    class iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = AVLMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = value_type*;
+        using reference = value_type&;
+
+        iterator() = default;
+
+        /**
+         * @param position in the tree.
+         */
+        explicit iterator(const_iterator position): position{position} {}
+
+        reference operator*() const {
+            // the pair lives in a non-const node, & its key is const on its own
+            return const_cast<reference>(*position);
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        iterator& operator++() {
+            ++position;
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator result{*this};
+            ++position;
+            return result;
+        }
+
+        iterator& operator--() {
+            --position;
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator result{*this};
+            --position;
+            return result;
+        }
+
+        operator const_iterator() const {
+            return position;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) {
+            return lhs.position == rhs.position;
+        }
+
+        friend bool operator!=(const iterator& lhs, const iterator& rhs) {
+            return lhs.position != rhs.position;
+        }
+    private:
+        // Position in the tree.
+        const_iterator position{};
+    };
+
+    /**
+     * Constructs an empty map with a default constructed allocator.
+     */
+    AVLMap() = default;
+
+    /**
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes of the map.
+     */
+    explicit AVLMap(const Compare& comp, const Allocator& alloc = Allocator()):
+        tree(MapKeyCompare<K, V, Compare>(comp), alloc) {}
+
+    /**
+     * @param alloc allocator used for the nodes of the map.
+     */
+    explicit AVLMap(const Allocator& alloc): tree(alloc) {}
+
+    /**
+     * @return copy of the ordering of the keys.
+     */
+    [[nodiscard]] key_compare key_comp() const {
+        return tree.comparator.comparator;
+    }
+
+    /**
+     * @return copy of the allocator used by the map.
+     */
+    [[nodiscard]] allocator_type get_allocator() const {
+        return tree.get_allocator();
+    }
+
+    /**
+     * @return the underlying tree, for the queries of AVL such as rank() or range().
+     */
+    [[nodiscard]] const tree_type& base() const {
+        return tree;
+    }
+
+    /**
+     * @param key whose value is returned, inserted with a value-initialized value if absent.
+     * @return reference to the mapped value.
+     */
+    V& operator[](const K& key) {
+        return try_emplace(key).first->second;
+    }
+
+    /**
+     * @param key whose value is returned, moved in with a value-initialized value if absent.
+     * @return reference to the mapped value.
+     */
+    V& operator[](K&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    /**
+     * @param key whose value is returned.
+     * @return reference to the mapped value.
+     * @throws out_of_range if the key is absent.
+     */
+    V& at(const K& key) {
+        return const_cast<V&>(std::as_const(*this).at(key));
+    }
+
+    /**
+     * @param key whose value is returned.
+     * @return reference to the mapped value.
+     * @throws out_of_range if the key is absent.
+     */
+    [[nodiscard]] const V& at(const K& key) const {
+        const auto *node{tree.search(key)};
+
+        if (not node) {
+            throw std::out_of_range("AVLMap::at: key not present");
+        }
+
+        return node->key.second;
+    }
+
+    /**
+     * Builds the value only if the key is absent, in a single descent.
+     *
+     * @param key to be inserted, copied only if it is absent.
+     * @param args forwarded to the constructor of the value.
+     * @return iterator to the pair of the key, & true if it was inserted.
+     */
+    template <typename ...Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+        return emplaceKey(key, key, std::forward<Args>(args)...);
+    }
+
+    /**
+     * Builds the value only if the key is absent, in a single descent.
+     *
+     * @param key to be inserted, moved only if it is absent.
+     * @param args forwarded to the constructor of the value.
+     * @return iterator to the pair of the key, & true if it was inserted.
+     */
+    template <typename ...Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+        return emplaceKey(key, std::move(key), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @param key to be inserted if absent.
+     * @param value assigned to the mapped value, whether the key was present or not.
+     * @return iterator to the pair of the key, & true if it was inserted.
+     */
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& value) {
+        return assignKey(key, key, std::forward<M>(value));
+    }
+
+    /**
+     * @param key to be moved in if absent.
+     * @param value assigned to the mapped value, whether the key was present or not.
+     * @return iterator to the pair of the key, & true if it was inserted.
+     */
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(K&& key, M&& value) {
+        return assignKey(key, std::move(key), std::forward<M>(value));
+    }
+
+    /**
+     * @param value pair to be inserted, copied only if its key is absent.
+     * @return iterator to the pair of the key, & true if it was inserted.
+     */
+    std::pair<iterator, bool> insert(const value_type& value) {
+        const auto [position, inserted] = tree.insert(value);
+        return {iterator(position), inserted};
+    }
+
+    /**
+     * @param args forwarded to the constructor of the pair.
+     * @return iterator to the pair of the key, & true if it was inserted.
+     */
+    template <typename ...Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        const auto [position, inserted] = tree.emplace(std::forward<Args>(args)...);
+        return {iterator(position), inserted};
+    }
+
+    /**
+     * @param key of the pair to be removed, if present.
+     * @return number of removed pairs, 0 or 1.
+     */
+    size_type erase(const K& key) {
+        return tree.removeNode(key) ? 1 : 0;
+    }
+
+    /**
+     * Updates the value mapped to the key & removes the pair if asked to, in a single descent.
+     *
+     * @param key of the pair, if present.
+     * @param update called with the mapped value, returns true to remove the pair.
+     * @return true if the key was present.
+     */
+    template <typename Update>
+    bool update_or_erase(const K& key, Update&& update) {
+        bool found{false};
+
+        tree.removeNode(key, [&](value_type& pair) {
+            found = true;
+            return update(pair.second);
+        });
+
+        return found;
+    }
+
+    /**
+     * @param position of the pair to be removed, must be dereferenceable.
+     * @return iterator to the pair after the removed one.
+     */
+    iterator erase(const_iterator position) {
+        const_iterator next{std::next(position)};
+        tree.removeNode(position->first);
+        return iterator(next);
+    }
+
+    /**
+     * @param key of the pair to be unlinked, if present.
+     * @return handle owning the unlinked pair, empty if the key is absent.
+     */
+    node_type extract(const K& key) {
+        return tree.extractHandle(key);
+    }
+
+    /**
+     * @param key to search for.
+     * @return iterator to the pair of the key, end() if absent.
+     */
+    [[nodiscard]] iterator find(const K& key) {
+        return iterator(tree.iteratorTo(tree.search(key)));
+    }
+
+    /**
+     * @param key to search for.
+     * @return iterator to the pair of the key, end() if absent.
+     */
+    [[nodiscard]] const_iterator find(const K& key) const {
+        return tree.iteratorTo(tree.search(key));
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param key equivalent to the key searched for.
+     * @return iterator to the pair of the key, end() if absent.
+     */
+    template <typename L, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] iterator find(const L& key) {
+        return iterator(tree.iteratorTo(tree.search(key)));
+    }
+
+    /**
+     * @param key to search for.
+     * @return true if the key is present.
+     */
+    [[nodiscard]] bool contains(const K& key) const {
+        return tree.search(key);
+    }
+
+    /**
+     * @param key bound of the search.
+     * @return iterator to the first pair whose key is not before key.
+     */
+    [[nodiscard]] iterator lower_bound(const K& key) {
+        return iterator(tree.lower_bound(key));
+    }
+
+    /**
+     * @param key bound of the search.
+     * @return iterator to the first pair whose key is after key.
+     */
+    [[nodiscard]] iterator upper_bound(const K& key) {
+        return iterator(tree.upper_bound(key));
+    }
+
+    [[nodiscard]] iterator begin() {
+        return iterator(tree.begin());
+    }
+
+    [[nodiscard]] iterator end() {
+        return iterator(tree.end());
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        return tree.begin();
+    }
+
+    [[nodiscard]] const_iterator end() const {
+        return tree.end();
+    }
+
+    [[nodiscard]] const_iterator cbegin() const {
+        return tree.begin();
+    }
+
+    [[nodiscard]] const_iterator cend() const {
+        return tree.end();
+    }
+
+    /**
+     * @return true if the map holds no pair.
+     */
+    [[nodiscard]] bool empty() const {
+        return tree.empty();
+    }
+
+    /**
+     * @return number of pairs, in O(1) with a node policy counting subtree sizes, O(n) otherwise.
+     */
+    [[nodiscard]] size_type size() const {
+        return tree.size();
+    }
+private:
+    /**
+     * @param key to search for.
+     * @param stored key forwarded to the new pair, only used if the key is absent.
+     * @param args forwarded to the constructor of the value.
+     * @return iterator to the pair of the key, & true if it was inserted.
+     */
+    template <typename Key, typename ...Args>
+    std::pair<iterator, bool> emplaceKey(const K& key, Key&& stored, Args&&... args) {
+        const auto [node, inserted] = tree.insertNode(key, [&] {
+            return tree.createNode(
+                std::piecewise_construct,
+                std::forward_as_tuple(std::forward<Key>(stored)),
+                std::forward_as_tuple(std::forward<Args>(args)...)
+            );
+        });
+
+        return {iterator(tree.iteratorTo(node)), inserted};
+    }
+
+    /**
+     * @param key to search for.
+     * @param stored key forwarded to the new pair, only used if the key is absent.
+     * @param value assigned to, or used to build, the mapped value.
+     * @return iterator to the pair of the key, & true if it was inserted.
+     */
+    template <typename Key, typename M>
+    std::pair<iterator, bool> assignKey(const K& key, Key&& stored, M&& value) {
+        const auto [node, inserted] = tree.insertNode(key, [&] {
+            return tree.createNode(std::forward<Key>(stored), std::forward<M>(value));
+        });
+
+        if (not inserted) {
+            node->key.second = std::forward<M>(value);
+        }
+
+        return {iterator(tree.iteratorTo(node)), inserted};
+    }
+
+    // Tree of the pairs, ordered by key.
+    tree_type tree{};
+};
@@ -0,0 +1,213 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "AvlMap.cpp"
+
+
+/**
+ * Ordered multiset built on AVLMap, each node holding a key & its number of occurrences.
+ * Repeated keys cost neither a node nor any rebalancing.
+ *
+ * @tparam T type of the keys.
+ * @tparam Compare strict weak ordering of the keys.
+ * @tparam Allocator allocator of T, rebound to allocate the nodes.
+ * @tparam NodePolicy layout of the nodes, see NodePolicy.cpp. Subtree sizes count distinct keys.
+ */
+template <
+    typename T,
+    typename Compare = std::less<T>,
+    typename Allocator = std::allocator<T>,
+    typename NodePolicy = DefaultNodePolicy
+>
+class AVLMultiset {
+public:
+    /* Custom size type for the AVL tree */
+    typedef long long size_type;
+
+    /* Map from every distinct key to its number of occurrences */
+    using map_type = AVLMap<
+        T,
+        size_type,
+        Compare,
+        typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const T, size_type>>,
+        NodePolicy
+    >;
+
+    /* Iterates over the distinct keys, as (key, count) pairs */
+    using const_iterator = typename map_type::const_iterator;
+    using iterator = const_iterator;
+
+    /**
+     * Constructs an empty multiset with a default constructed allocator.
+     */
+    AVLMultiset() = default;
+
+    /**
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes of the multiset.
+     */
+    explicit AVLMultiset(const Compare& comp, const Allocator& alloc = Allocator()):
+        counts(comp, typename map_type::allocator_type(alloc)) {}
+
+    /**
+     * @param value to be inserted, a node is only allocated for its first occurrence.
+     * @param occurrences number of copies to be inserted, positive.
+     * @return number of occurrences of the value after the insertion.
+     * @throws invalid_argument if occurrences is not positive, the multiset is left unchanged.
+     */
+    size_type insert(const T& value, size_type occurrences = 1) {
+        if (occurrences < 1) {
+            throw std::invalid_argument("AVLMultiset::insert: occurrences must be positive");
+        }
+
+        const auto [position, inserted] = counts.try_emplace(value, 0);
+        total += occurrences;
+        return position->second += occurrences;
+    }
+
+    /**
+     * @param key to be counted.
+     * @return number of occurrences of the key, 0 if absent.
+     */
+    [[nodiscard]] size_type count(const T& key) const {
+        const auto position{counts.find(key)};
+        return position == counts.end() ? 0 : position->second;
+    }
+
+    /**
+     * @param key to search for.
+     * @return true if the key occurs at least once.
+     */
+    [[nodiscard]] bool contains(const T& key) const {
+        return counts.contains(key);
+    }
+
+    /**
+     * Removes a single occurrence, the node is only unlinked with the last one.
+     *
+     * @param key whose occurrence is to be removed, if present.
+     * @return true if an occurrence was removed.
+     */
+    bool erase_one(const T& key) {
+        // the count is decremented during the descent that unlinks the node with the last occurrence
+        if (not counts.update_or_erase(key, [](size_type& occurrences) { return --occurrences == 0; })) {
+            return false;
+        }
+
+        --total;
+        return true;
+    }
+
+    /**
+     * Removes every occurrence of the key.
+     *
+     * @param key to be removed, if present.
+     * @return number of removed occurrences.
+     */
+    size_type erase(const T& key) {
+        const auto handle{counts.extract(key)};
+
+        if (handle.empty()) {
+            return 0;
+        }
+
+        total -= handle.value().second;
+
+        return handle.value().second;
+    }
+
+    /**
+     * @param key to search for.
+     * @return iterator to the (key, count) pair of the key, end() if absent.
+     */
+    [[nodiscard]] const_iterator find(const T& key) const {
+        return counts.find(key);
+    }
+
+    /**
+     * @param key bound of the search.
+     * @return iterator to the first distinct key not before key.
+     */
+    [[nodiscard]] const_iterator lower_bound(const T& key) const {
+        return counts.base().lower_bound(key);
+    }
+
+    /**
+     * @param key bound of the search.
+     * @return iterator to the first distinct key after key.
+     */
+    [[nodiscard]] const_iterator upper_bound(const T& key) const {
+        return counts.base().upper_bound(key);
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        return counts.begin();
+    }
+
+    [[nodiscard]] const_iterator end() const {
+        return counts.end();
+    }
+
+    /**
+     * @return true if the multiset holds no key.
+     */
+    [[nodiscard]] bool empty() const {
+        return counts.empty();
+    }
+
+    /**
+     * @return number of keys, every occurrence included, in O(1).
+     */
+    [[nodiscard]] size_type size() const {
+        return total;
+    }
+
+    /**
+     * @return number of distinct keys.
+     */
+    [[nodiscard]] size_type distinct() const {
+        return counts.size();
+    }
+
+    /**
+     * @return the underlying map from the distinct keys to their counts.
+     */
+    [[nodiscard]] const map_type& base() const {
+        return counts;
+    }
+private:
+    // Number of occurrences of every distinct key.
+    map_type counts{};
+
+    // Number of keys, every occurrence included.
+    size_type total{0};
+};
@@ -0,0 +1,280 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ConcurrentAvl.cpp"
+#include "PersistentAvl.cpp"
+#include "ShardedAvl.cpp"
+
+
+/**
+ * Multi-threaded stress of ConcurrentAVL, ShardedAVL & PersistentAVL, meant to run under AVL_SANITIZE=thread.
+ * Each writer owns a disjoint set of keys, so its own std::set predicts every result,
+ * while the keys present from the start must stay visible to every reader.
+ */
+
+/**
+ * Reports the failed check & aborts.
+ *
+ * @param condition expected to hold.
+ * @param what description of the check.
+ */
+static void stressCheck(bool condition, const char *what) {
+    if (not condition) {
+        std::fprintf(stderr, "avl_stress: %s\n", what);
+        std::abort();
+    }
+}
+
+// Keys drawn by the writers & the readers, the even ones are inserted up-front & never modified.
+static constexpr int stress_key_range{1 << 12};
+
+/**
+ * @param visit for_each() of a tree or a version.
+ * @return the keys visited, checked to be strictly increasing with every even key present.
+ */
+template <typename ForEach>
+std::vector<int> stressTraversal(ForEach&& visit) {
+    std::vector<int> keys;
+    visit([&](int key) { keys.push_back(key); });
+
+    stressCheck(std::adjacent_find(keys.begin(), keys.end(), std::greater_equal<int>()) == keys.end(),
+                "traversal is not strictly increasing");
+    stressCheck(std::count_if(keys.begin(), keys.end(), [](int key) { return key % 2 == 0; }) == stress_key_range / 2,
+                "traversal lost a stable key");
+
+    return keys;
+}
+
+/**
+ * @param condition expected to hold.
+ * @param tree name of the stressed tree.
+ * @param what description of the check.
+ */
+static void stressCheck(bool condition, const char *tree, const char *what) {
+    if (not condition) {
+        std::fprintf(stderr, "avl_stress: %s: %s\n", tree, what);
+        std::abort();
+    }
+}
+
+/**
+ * Writers insert & remove their odd keys while readers look up & traverse the tree.
+ *
+ * @param tree empty ConcurrentAVL or ShardedAVL of int keys.
+ * @param name of the tree in the reports.
+ * @param duration of the run.
+ * @param writers number of writer threads.
+ * @param readers number of reader threads.
+ */
+template <typename Tree>
+void stressConcurrent(Tree& tree, const char *name, std::chrono::milliseconds duration, unsigned writers, unsigned readers) {
+
+    for (int key{0}; key < stress_key_range; key += 2) {
+        tree.insert(key);
+    }
+
+    std::atomic<bool> stop{false};
+    std::vector<std::set<int>> oracles(writers);
+    std::vector<std::thread> threads;
+
+    for (unsigned writer{0}; writer < writers; ++writer) {
+        threads.emplace_back([&, writer] {
+            std::mt19937 random{writer};
+            auto& oracle{oracles[writer]};
+
+            while (not stop.load(std::memory_order_relaxed)) {
+                // odd keys congruent to the writer, modulo the number of writers
+                const int key{2 * static_cast<int>(writer + writers * (random() % (stress_key_range / 2 / writers))) + 1};
+
+                if (random() % 2) {
+                    stressCheck(tree.insert(key) == oracle.insert(key).second, name, "insert() result differs");
+                } else {
+                    stressCheck(tree.remove(key) == (oracle.erase(key) == 1), name, "remove() result differs");
+                }
+
+                stressCheck(tree.contains(key) == (oracle.count(key) == 1), name, "contains() misses a write");
+            }
+        });
+    }
+
+    for (unsigned reader{0}; reader < readers; ++reader) {
+        threads.emplace_back([&, reader] {
+            std::mt19937 random{1000 + reader};
+
+            while (not stop.load(std::memory_order_relaxed)) {
+                const int key{static_cast<int>(random() % stress_key_range)};
+                const int stable{key & ~1};
+
+                stressCheck(tree.contains(stable), name, "contains() lost a stable key");
+                stressCheck(tree.find(stable) == stable, name, "find() lost a stable key");
+
+                // the largest key is odd, past it there may be no key at all
+                const auto lower{tree.lower_bound(key)};
+                stressCheck(lower ? *lower >= key and *lower <= key + 1 : key == stress_key_range - 1,
+                            name, "lower_bound() differs");
+
+                if constexpr (std::is_same_v<Tree, ConcurrentAVL<int>>) {
+                    const auto upper{tree.upper_bound(stable)};
+                    stressCheck(upper ? *upper > stable and *upper <= stable + 2 : stable + 2 == stress_key_range,
+                                name, "upper_bound() differs");
+                }
+
+                if (random() % 256 == 0) {
+                    stressTraversal([&](auto&& visit) { tree.for_each(visit); });
+                }
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop.store(true, std::memory_order_relaxed);
+
+    for (auto& thread: threads) {
+        thread.join();
+    }
+
+    std::set<int> expected;
+
+    for (int key{0}; key < stress_key_range; key += 2) {
+        expected.insert(key);
+    }
+
+    for (const auto& oracle: oracles) {
+        expected.insert(oracle.begin(), oracle.end());
+    }
+
+    const auto keys{stressTraversal([&](auto&& visit) { tree.for_each(visit); })};
+    stressCheck(std::equal(keys.begin(), keys.end(), expected.begin(), expected.end()), name, "content differs");
+    stressCheck(tree.size() == static_cast<typename Tree::size_type>(expected.size()), name, "size() differs");
+}
+
+/**
+ * Every thread modifies its own version of a shared base, whose nodes are then released concurrently.
+ * The base version must not change.
+ *
+ * @param duration of the run.
+ * @param threads number of threads.
+ */
+void stressPersistent(std::chrono::milliseconds duration, unsigned threads) {
+    PersistentAVL<int> base;
+
+    for (int key{0}; key < stress_key_range; key += 2) {
+        base.insert(key);
+    }
+
+    const auto deadline{std::chrono::steady_clock::now() + duration};
+    std::vector<std::thread> workers;
+
+    for (unsigned worker{0}; worker < threads; ++worker) {
+        // versions are copied before the threads start, a version is not safe to copy while it is modified
+        workers.emplace_back([&base, deadline, worker, version = base.snapshot()]() mutable {
+            std::mt19937 random{2000 + worker};
+            std::set<int> oracle;
+            version.for_each([&](int key) { oracle.insert(key); });
+
+            while (std::chrono::steady_clock::now() < deadline) {
+                const int key{static_cast<int>(random() % stress_key_range)};
+
+                switch (random() % 4) {
+                    case 0:
+                        stressCheck(version.insert(key) == oracle.insert(key).second, "PersistentAVL::insert() result differs");
+                        break;
+                    case 1:
+                        stressCheck(version.remove(key) == (oracle.erase(key) == 1), "PersistentAVL::remove() result differs");
+                        break;
+                    case 2: {
+                        // drops the current version for a snapshot, releasing nodes shared with the others
+                        auto snapshot{version.snapshot()};
+                        version = std::move(snapshot);
+                        break;
+                    }
+                    default:
+                        stressCheck(version.contains(key) == (oracle.count(key) == 1), "PersistentAVL::contains() differs");
+                        stressCheck(base.contains(key) == (key % 2 == 0), "PersistentAVL base version changed");
+                        break;
+                }
+            }
+
+            std::vector<int> keys;
+            version.for_each([&](int key) { keys.push_back(key); });
+            stressCheck(std::equal(keys.begin(), keys.end(), oracle.begin(), oracle.end()), "PersistentAVL content differs");
+            stressCheck(version.size() == static_cast<PersistentAVL<int>::size_type>(oracle.size()), "PersistentAVL::size() differs");
+        });
+    }
+
+    for (auto& worker: workers) {
+        worker.join();
+    }
+
+    const auto keys{stressTraversal([&](auto&& visit) { base.for_each(visit); })};
+    stressCheck(keys.size() == stress_key_range / 2, "PersistentAVL base version changed");
+}
+
+/**
+ * Usage: avl_stress [milliseconds [threads]], each variant runs for the given time.
+ */
+int main(int argc, char **argv) {
+    const std::chrono::milliseconds duration{argc > 1 ? std::strtol(argv[1], nullptr, 10) : 2000};
+    const unsigned threads{argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 4};
+    const unsigned writers{std::max(1u, threads / 2)};
+
+    std::fprintf(stderr, "avl_stress: %lld ms, %u threads\n", static_cast<long long>(duration.count()), threads);
+
+    const unsigned readers{std::max(1u, threads - writers)};
+
+    ConcurrentAVL<int> concurrent;
+    stressConcurrent(concurrent, "ConcurrentAVL", duration, writers, readers);
+
+    // shards allocating from pools, which are not thread-safe, on concurrent writes
+    ShardedAVL<int, HashPartition<int>, std::less<int>, PoolAllocator<int>> hashed{HashPartition<int>(8)};
+    stressConcurrent(hashed, "ShardedAVL<HashPartition>", duration, writers, readers);
+
+    using Instrumented = InstrumentedAllocator<PoolAllocator<int>>;
+    std::vector<int> splitters;
+
+    for (int key{stress_key_range / 8}; key < stress_key_range; key += stress_key_range / 8) {
+        splitters.push_back(key);
+    }
+
+    ShardedAVL<int, RangePartition<int>, std::less<int>, Instrumented> ranged{RangePartition<int>(splitters)};
+    stressConcurrent(ranged, "ShardedAVL<RangePartition>", duration, writers, readers);
+
+    stressPersistent(duration, std::max(1u, threads));
+
+    return 0;
+}
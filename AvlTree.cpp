@@ -1,644 +1,3763 @@
-/*
- * MIT License
- *
- *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to deal
- * in the Software without restriction, including without limitation the rights
- * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
- * copies of the Software, and to permit persons to whom the Software is
- * furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in all
- * copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
- * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
- * SOFTWARE.
- */
-
-#include <algorithm>
-#include <iostream>
-#include <sstream>
-#include <utility>
-#include <vector>
-
-using namespace std;
-
-
-/**
- * @tparam T type of the data stored in the AVL tree.
- */
-template <typename T>
-class AVL {
-public:
-    /* Custom size type for the AVL tree */
-    typedef long long size_type;
-
-    /**
-     * Simple class used to represent nodes in the AVL tree.
-     */
-    class Node {
-    public:
-        /*
-         * Data field of type T, stores the value inside the node.
-         */
-        T key;
-
-        /*
-         * Height of the subtree whose root is this node instance.
-         */
-        size_type height;
-
-        /*
-         * Node pointer to the left child.
-         */
-        Node *left;
-
-        /*
-         * Node pointer to the left child.
-         */
-        Node *right;
-
-        /**
-         * Initializes height to 1, left to nullptr, & right to nullptr.
-         *
-         * @param value stored inside the node.
-         */
-        explicit Node(T value): height{1}, key{value}, left{nullptr}, right{nullptr} {}
-    };
-
-    /**
-     * @param value to be inserted into the AVL tree.
-     */
-    [[maybe_unused]] void insert(const T& value) {
-        root = insert(root, value);
-    }
-
-    /**
-     * @param value first value to be inserted
-     * @param values rest of the value to be inserted
-     */
-    template <typename ...Args>
-    [[maybe_unused]] void insert(const T& value, Args... values) {
-        root = insert(root, value);
-        insert(values...);
-    }
-
-    /**
-     * @param value to be deleted from the AVL tree, if present.
-     */
-    [[maybe_unused]] void remove(const T& value) {
-        root = remove(root, value);
-    }
-
-    /**
-     * @param value to be searched for in the AVL tree.
-     * @return nullptr if the value does not exist in the tree.
-     *         Otherwise, a pointer to the node, closest to the root, having the value.
-     */
-    [[maybe_unused]] Node* search(const T& value) {
-        return search(root, value);
-    }
-
-    /**
-     * @return pointer to the root node.
-     */
-    [[maybe_unused]] inline Node* getRoot() {
-        return root;
-    }
-
-    /**
-     * @param node pointer to a node in the tree.
-     * @return the height of the node. If nullptr, returns 0.
-     */
-    static size_type height(Node *node) {
-        return node ? node->height : 0;
-    }
-
-    /**
-     * @return the height of the tree.
-     */
-    [[nodiscard]] size_type height() {
-        return height(root);
-    }
-private:
-    /**
-     * Struct used in in the DisplayGrid data-type alias.
-     */
-    struct cell_display {
-        // String value in the cell.
-        string value;
-
-        // True indicates that the value is present and should be displayed.
-        bool present;
-
-        // No-arg constructor for the struct.
-        cell_display(): present{false} {}
-
-        /**
-         * @param value to be stored in the value data field. Initializes present to true.
-         */
-        explicit cell_display(string value): value{std::move(value)}, present{true} {}
-    };
-
-    // Type alias for the display rows.
-    using DisplayGrid = vector<vector<cell_display>>;
-
-    /*
-     * Node pointer to the root node of the tree.
-     */
-    Node *root{nullptr};
-
-    /**
-     * @param root to start the search from.
-     * @param value to search for in the AVL tree.
-     * @return nullptr if the value does not exist in the tree.
-     *         Otherwise, a pointer to the node, closest to the root, having the value.
-     */
-    static Node* search(Node * root, const T& value) {
-        if (not root) {
-            return nullptr;
-        }
-
-        if (root->key == value) {
-            return root;
-        }
-
-        if (root->key < value) {
-            return search(root->right, value);
-        }
-
-        // root->key > value
-        return search(root->left, value);
-    }
-
-    /**
-     * @param root of a subtree to perform a right rotation on.
-     * @return the new root for the subtree.
-     */
-    static Node* rightRotation(Node *root) {
-        Node *new_root = root->left;
-        root->left = new_root->right;
-        new_root->right = root;
-
-        // update height for roots
-        root->height = 1 + max(height(root->left), height(root->right));
-        new_root->height = 1 + max(height(new_root->left), height(new_root->right));
-
-        return new_root;
-    }
-
-    /**
-     * @param root of a subtree to perform a left rotation on.
-     * @return the new root for the subtree.
-     */
-    static Node* leftRotation(Node *root) {
-        Node *new_head = root->right;
-        root->right = new_head->left;
-        new_head->left = root;
-
-        // update height for roots
-        root->height = 1 + max(height(root->left), height(root->right));
-        new_head->height = 1 + max(height(new_head->left), height(new_head->right));
-
-        return new_head;
-    }
-
-    /**
-     * @param root of the subtree to insert the value in.
-     * @param value to be inserted in the subtree.
-     * @return pointer to the new root of the subtree after performing the insertion & possible rotations.
-     */
-    static Node* insert(Node *root, const T& value) {
-        // the subtree is empty
-        if (not root) {
-            return new Node(value);
-        }
-
-        if (value < root->key) {
-            // Value less than root, go to left subtree
-            root->left = insert(root->left, value);
-        } else if (value > root->key) {
-            // Value greater than root, go to right subtree
-            root->right = insert(root->right, value);
-        }
-
-        // update root height
-        root->height = 1 + max(height(root->left), height(root->right));
-
-        // calculate new root balance
-        const auto balance{height(root->left) - height(root->right)};
-
-        if (1 < balance) {
-            if (value < root->left->key) {
-                return rightRotation(root);
-            } else {
-                root->left = leftRotation(root->left);
-                return rightRotation(root);
-            }
-        } else if (balance < -1) {
-            if (value > root->right->key) {
-                return leftRotation(root);
-            } else {
-                root->right = rightRotation(root->right);
-                return leftRotation(root);
-            }
-        }
-
-        return root;
-    }
-
-    /**
-     * @param root of the subtree to remove the value from.
-     * @param value to be removed from the subtree, if present.
-     * @return pointer to the new root of the subtree after performing the removal & possible rotations.
-     */
-    static Node* remove(Node *root, const T& value) {
-        // Tree is empty
-        if (not root) {
-            return nullptr;
-        }
-
-        if (value < root->key) {
-            // Check left subtree
-            root->left = remove(root->left, value);
-        } else if (value > root->key) {
-            // Check right subtree
-            root->right = remove(root->right, value);
-        } else { // We found the value
-            // Temporary holder for the right node
-            Node *right{root->right};
-
-            if (not root->right) { // Does not have right child
-                Node *left{root->left};
-
-                // Deallocate old value
-                delete root;
-
-                root = left;
-            } else if (not root->left) { // Does not have left child
-                delete root;
-
-                root = right;
-            } else { // Has both children
-                while(right->left and right->left->left) {
-                    // go right until we encounter a node that either does not have a left child
-                    // or has a left child that does not have a left child
-                    right = right->left;
-                }
-
-                if (not right->left) {
-                    // right does not have a left child
-                    root->key = right->key;
-                    root->right = right->right;
-                    delete right;
-                } else {
-                    // right has a child that does not have a left child
-                    const auto temp{right->left};
-                    root->key = right->left->key;
-                    right->left = nullptr;
-                    delete temp;
-                }
-            }
-        }
-
-        // Tree became empty
-        if (not root) {
-            return root;
-        }
-
-        // update height
-        root->height = 1 + max(height(root->left), height(root->right));
-
-        // calculate new balance
-        auto balance{height(root->left) - height(root->right)};
-
-        if (balance > 1) {
-            if (height(root->left) >= height(root->right)) {
-                return rightRotation(root);
-            } else {
-                root->left = leftRotation(root->left);
-                return rightRotation(root);
-            }
-        } else if (balance < -1) {
-            if (height(root->right) >= height(root->left)) {
-                return leftRotation(root);
-            } else {
-                root->right = rightRotation(root->right);
-                return leftRotation(root);
-            }
-        }
-
-        return root;
-    }
-
-    /**
-     * @return a vector of vectors of cell_display structs.
-     *         Each vector of cell_display structs represents one row, starting at the root.
-     */
-    DisplayGrid generateDisplayGrid() const {
-        // build a vector of vectors of Node pointers
-        vector<Node*> traversal_stack;
-        vector<vector<Node*>> rows;
-
-        if (not root) {
-            return DisplayGrid();
-        }
-
-        Node *current{root};
-        const auto max_depth{root->height};
-        rows.resize(max_depth);
-        size_type depth{0};
-
-        while(true) {
-            // Max-height Nodes are always a leaf or null
-            // This special case blocks deeper traversal
-            if (depth == max_depth - 1) {
-                rows[depth].push_back(current);
-
-                if (depth == 0) {
-                    break;
-                }
-
-                depth--;
-                continue;
-            }
-
-            // First visit to Node? Go to left child.
-            if (traversal_stack.size() == depth) {
-                rows[depth].push_back(current);
-                traversal_stack.push_back(current);
-
-                if (current) {
-                    current = current->left;
-                }
-
-                ++depth;
-                continue;
-            }
-
-            // Odd child count? Go to right child.
-            if (rows[depth + 1].size() % 2) {
-                current = traversal_stack.back();
-                if (current) {
-                    current = current->right;
-                }
-
-                ++depth;
-                continue;
-            }
-
-            // Time to leave if we get here
-
-            // Exit loop if this is the root
-            if (depth == 0) {
-                break;
-            }
-
-            traversal_stack.pop_back();
-            current = traversal_stack.back();
-            depth--;
-        }
-
-        /*
-         * Use rows of Node pointers to populate rows of cell_display structs.
-         * All possible slots in the tree get a cell_display struct,
-         * so if there is no actual Node at the struct location,
-         * its boolean "present" field is set to false.
-         * The struct also contains a string representation of
-         * its Node's value, created using a stringstream object.
-         */
-        DisplayGrid result{};
-        stringstream ss{};
-
-        for(const auto& row: rows) {
-            result.emplace_back();
-
-            for(Node* pn: row) {
-                if (pn) {
-                    ss << pn->key;
-                    result.back().push_back(cell_display(ss.str()));
-                    ss = stringstream();
-                } else {
-                    result.back().push_back(cell_display());
-                }
-            }
-        }
-
-        return result;
-    }
-
-    /**
-     * @param grid vector of rows of cell_display structs.
-     * @return formats the grid generated by generateDisplayGrid() into a test representation
-     *         as a vector of strings to be printed.
-     */
-    vector<string> formatGrid(const DisplayGrid& grid) const {
-        //  maximum value string length, minimum width is 3.
-        size_type cell_width{3};
-
-        for(const auto& row: grid) {
-            for(const auto& cell: row) {
-                if (cell.present and cell_width < cell.value.length()) {
-                    cell_width = cell.value.length();
-                }
-            }
-        }
-
-        // make sure the cell_width is an odd number
-        if (cell_width % 2 == 0) {
-            cell_width++;
-        }
-
-        // formatted rows
-        vector<string> result{};
-
-        // some of these counting variables are related,
-        // so its should be possible to eliminate some of them.
-        size_type row_count{static_cast<size_type>(grid.size())};
-
-        // this row's element count, a power of two
-        size_type row_elem_count{1 << (row_count - 1)};
-
-        // left_pad holds the number of space chars at the beginning of the bottom row
-        size_type left_pad{0};
-
-        // holds the current row value
-        string row{};
-
-        // Work from the level of maximum height, up to the root
-        // ("formatted_rows" will need to be reversed when done)
-        for(size_type r{0}; r < row_count; r++) {
-            const auto& gridRow = grid[row_count - r - 1]; // r reverse-indexes the row
-
-            /*
-             * "space" will be the number of rows of slashes needed to get
-             * from this row to the next.  It is also used to determine other
-             * text offsets.
-             */
-            size_type space{(size_type(1) << r) * (cell_width + 1) / 2 - 1};
-
-            row.clear();
-
-            // iterate over each element in this grid row
-            for(size_type c{0}; c < row_elem_count; c++) {
-                // add padding, more when this is not the leftmost element
-                row += string(c ? 2 * left_pad + 1 : left_pad, ' ');
-
-                if (gridRow[c].present) {
-                    // This position corresponds to an existing Node
-                    const string& nodeValue = gridRow[c].value;
-
-                    /*
-                     * Try to pad the left and right sides of the value string
-                     * with the same number of spaces.  If padding requires an
-                     * odd number of spaces, right-sided children get the longer
-                     * padding on the right side, while left-sided children
-                     * get it on the left side.
-                     */
-                    size_type long_padding{cell_width - static_cast<size_type>(nodeValue.length())};
-                    size_type short_padding{long_padding / 2};
-
-                    long_padding -= short_padding;
-
-                    row += string(c % 2 ? short_padding : long_padding, ' ');
-                    row += nodeValue;
-                    row += string(c % 2 ? long_padding : short_padding, ' ');
-                } else {
-                    // This position is empty
-                    row += string(cell_width, ' ');
-                }
-            }
-
-            // A row of spaced-apart value strings is ready, add it to the result vector
-            result.push_back(row);
-
-            // The root has been added, so this loop is done
-            if (row_elem_count == 1) {
-                break;
-            }
-
-            /*
-             * Add rows of forward- and back- slash characters, spaced apart
-             * to "connect" two rows' Node value strings.
-             * The "space" variable counts the number of rows needed here.
-             */
-            size_type left_space{space + 1};
-            size_type right_space{space - 1};
-
-            for(size_type i{0}; i < space; i++) {
-                row.clear();
-
-                for (size_type c{0}; c < row_elem_count; c++) {
-                    if (c % 2 == 0) {
-                        row += string(c ? 2 * left_space + 1 : left_space, ' ');
-                        row += gridRow[c].present ? '/' : ' ';
-                        row += string(right_space + 1, ' ');
-                    } else {
-                        row += string(right_space, ' ');
-                        row += gridRow[c].present ? '\\' : ' ';
-                    }
-                }
-
-                result.push_back(row);
-                left_space++;
-                right_space--;
-            }
-
-            left_pad += space + 1;
-            row_elem_count /= 2;
-        }
-
-        // Reverse the result, placing the root Node at the beginning (top)
-        reverse(result.begin(), result.end());
-
-        return result;
-    }
-
-    /**
-     * Trims an equal number of space characters from
-     * the beginning of each string in the vector.
-     * At least one string in the vector will end up beginning
-     * with no space characters.
-     *
-     * @param rows to be trimmed
-     */
-    static void trimRowsLeft(vector<string>& rows) {
-        if (rows.empty()) {
-            return;
-        }
-
-        auto min_space = rows.front().length();
-        for(const auto& row: rows) {
-            auto i = row.find_first_not_of(' ');
-
-            if (i == string::npos) {
-                i = row.length();
-            }
-
-            if (i == 0) {
-                // A trimmed string already exists
-                return;
-            }
-
-            if (i < min_space) {
-                min_space = i;
-            }
-        }
-
-        for(auto& row: rows) {
-            row.erase(0, min_space);
-        }
-    }
-
-    /**
-     * @param out output stream to display the AVL tree to
-     * @return reference to the given output stream
-     */
-    ostream& display(ostream& out) {
-        // If this tree is empty, tell someone
-        if (height() == 0) {
-            return out << "<empty tree>" << endl;
-        }
-
-        const auto grid = generateDisplayGrid();
-
-        // then format these into a text representation...
-        auto formattedGrid = formatGrid(grid);
-
-        // then trim excess space characters from the left sides of the text...
-        trimRowsLeft(formattedGrid);
-
-        // then dump the text to out.
-        for (const auto& row: formattedGrid) {
-            out << ' ' << row << '\n';
-        }
-
-        return out;
-    }
-
-    /**
-     * @param out output stream to display the tree to.
-     * @param tree to be displayed.
-     * @return reference to the given output stream.
-     */
-    template<typename C>
-    friend ostream& operator<<(ostream& out, AVL<C>& tree);
-};
-
-/**
- * @tparam T type stored in the AVL tree. Implicitly inferred.
- * @param out output stream to display the tree to.
- * @param tree to be displayed.
- * @return reference to the given output stream.
- */
-template<typename T>
-ostream& operator<<(ostream &out, AVL<T>& tree) {
-    return tree.display(out);
-}
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef AVL_TREE_CPP
+#define AVL_TREE_CPP
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "AvlImage.cpp"
+#include "FrozenAvl.cpp"
+#include "NodePolicy.cpp"
+#include "NodePool.cpp"
+#include "TreeStatistics.cpp"
+#include "WorkStealingPool.cpp"
+
+#ifndef AVL_CHECK_INVARIANTS
+#define AVL_CHECK_INVARIANTS 0
+#endif
+
+
+/**
+ * True if a.compare(b) is a valid expression, as for strings & string views.
+ */
+template <typename A, typename B, typename = void>
+struct has_compare_member: std::false_type {};
+
+template <typename A, typename B>
+struct has_compare_member<A, B, std::void_t<decltype(std::declval<const A&>().compare(std::declval<const B&>()))>>: std::true_type {};
+
+/**
+ * True if the comparator has a three-way comparator.compare(a, b) returning an int.
+ */
+template <typename Compare, typename A, typename B, typename = void>
+struct has_three_way: std::false_type {};
+
+template <typename Compare, typename A, typename B>
+struct has_three_way<Compare, A, B, std::void_t<
+    decltype(std::declval<const Compare&>().compare(std::declval<const A&>(), std::declval<const B&>()))
+>>: std::true_type {};
+
+/**
+ * Transparent less-than comparator with a three-way compare(a, b).
+ * With it the tree compares once per level, & stops at the matching node.
+ */
+struct ThreeWayLess {
+    using is_transparent = void;
+
+    template <typename A, typename B>
+    bool operator()(const A& a, const B& b) const {
+        return a < b;
+    }
+
+    /**
+     * @return negative if a comes before b, positive if after, 0 if equivalent.
+     */
+    template <typename A, typename B>
+    int compare(const A& a, const B& b) const {
+        if constexpr (has_compare_member<A, B>::value) {
+            const auto order{a.compare(b)};
+            return (0 < order) - (order < 0);
+        } else {
+            return (b < a) - (a < b);
+        }
+    }
+};
+
+/**
+ * Tag selecting the constructors that expect sorted input without duplicates.
+ */
+struct sorted_unique_t {
+    explicit sorted_unique_t() = default;
+};
+
+inline constexpr sorted_unique_t sorted_unique{};
+
+/**
+ * Limits of AVL::display(), to draw large trees.
+ */
+struct AvlDisplayOptions {
+    // Levels of keys drawn below the rendered root, deeper subtrees are drawn as "[n keys]" placeholders.
+    long long max_depth{std::numeric_limits<long long>::max()};
+
+    // Subtrees holding more keys are drawn as placeholders, except the rendered root. 0 never collapses.
+    long long collapse_above{0};
+};
+
+/*
+ * Key/value map over the AVL tree, see AvlMap.cpp.
+ */
+template <typename K, typename V, typename Compare, typename Allocator, typename NodePolicy>
+class AVLMap;
+
+
+/**
+ * @tparam T type of the data stored in the AVL tree.
+ * @tparam Compare strict weak ordering of the keys.
+ *                 A transparent comparator (is_transparent) enables lookups by other key types,
+ *                 a three-way compare(a, b) member is used on the hot paths when present.
+ * @tparam Allocator std::allocator-compatible allocator, rebound to allocate the nodes.
+ *                   PoolAllocator keeps the nodes in contiguous recycled slabs.
+ *                   InstrumentedAllocator turns on the statistics of stats().
+ * @tparam NodePolicy layout of the nodes, see NodePolicy.cpp.
+ */
+template <
+    typename T,
+    typename Compare = std::less<T>,
+    typename Allocator = std::allocator<T>,
+    typename NodePolicy = DefaultNodePolicy
+>
+class AVL {
+public:
+    /* Custom size type for the AVL tree */
+    typedef long long size_type;
+
+    /* Allocator type given by the user */
+    typedef Allocator allocator_type;
+
+    /* Ordering of the keys */
+    typedef Compare key_compare;
+
+    /**
+     * Simple class used to represent nodes in the AVL tree.
+     * Holds a parent link, a subtree size & a subtree summary as well if the node policy asks for them.
+     */
+    class Node:
+        public NodeParentField<typename NodePolicy::template link_type<Node>, NodePolicy::parent_links>,
+        public NodeSizeField<typename NodePolicy::subtree_size_type>,
+        public NodeSummaryField<typename NodePolicy::augmentation> {
+    public:
+        /*
+         * Data field of type T, stores the value inside the node.
+         */
+        T key;
+
+        /*
+         * Height of the subtree whose root is this node instance.
+         */
+        typename NodePolicy::height_type height;
+
+        /*
+         * Node pointer to the left child.
+         */
+        typename NodePolicy::template link_type<Node> left;
+
+        /*
+         * Node pointer to the left child.
+         */
+        typename NodePolicy::template link_type<Node> right;
+
+        /**
+         * Initializes height to 1, left to nullptr, & right to nullptr.
+         *
+         * @param args forwarded to the constructor of the key, which is built in place.
+         */
+        template <typename ...Args>
+        explicit Node(std::in_place_t, Args&&... args):
+            key(std::forward<Args>(args)...), height{1}, left{nullptr}, right{nullptr} {
+            if constexpr (not std::is_void_v<typename NodePolicy::augmentation>) {
+                this->summary = NodePolicy::augmentation::lift(key);
+            }
+        }
+    };
+private:
+    // Allocator rebound to the node type, and its traits.
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+    /*
+     * Upper bound on the height of any AVL tree whose size fits in size_type.
+     * A tree of height h holds at least F(h + 2) - 1 nodes, F being the Fibonacci sequence,
+     * and F(94) already exceeds the largest size_type.
+     */
+    static constexpr size_type max_height{92};
+
+    /*
+     * Number of descents search_batch() interleaves, enough in flight to cover the latency of a cache miss.
+     */
+    static constexpr std::size_t batch_group{16};
+
+public:
+
+    /**
+     * Bidirectional iterator over the keys of the tree, in order.
+     * Keys are immutable through iterators, since changing them would break the tree order.
+     *
+     * Increments climb through the parent links when the node policy has them, in amortized O(1).
+     * Otherwise the successor is found by descending from the root, in O(log n).
+     */
+    class iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        iterator() = default;
+
+        reference operator*() const {
+            return node->key;
+        }
+
+        pointer operator->() const {
+            return &node->key;
+        }
+
+        iterator& operator++() {
+            node = tree->successor(node);
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator result{*this};
+            ++*this;
+            return result;
+        }
+
+        iterator& operator--() {
+            // decrementing end() gives the last key
+            node = node ? tree->predecessor(node) : maximum(tree->root);
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator result{*this};
+            --*this;
+            return result;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) {
+            return lhs.node == rhs.node;
+        }
+
+        friend bool operator!=(const iterator& lhs, const iterator& rhs) {
+            return lhs.node != rhs.node;
+        }
+    private:
+        friend class AVL;
+
+        /**
+         * @param node pointed to, nullptr for the end iterator.
+         * @param tree the node belongs to.
+         */
+        iterator(Node *node, const AVL *tree): node{node}, tree{tree} {}
+
+        // Current node, nullptr past the last key.
+        Node *node{nullptr};
+
+        // Tree being iterated over.
+        const AVL *tree{nullptr};
+    };
+
+    using const_iterator = iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = reverse_iterator;
+
+    /**
+     * Forward cursor over the keys of a range, keeping the pending ancestors on a fixed-size stack.
+     * Subtrees before the range are never entered, & the cursor stops at the first key past it,
+     * so a scan of k keys costs O(log n + k) without any allocation.
+     */
+    class range_cursor {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        range_cursor() = default;
+
+        reference operator*() const {
+            return stack[depth - 1]->key;
+        }
+
+        pointer operator->() const {
+            return &stack[depth - 1]->key;
+        }
+
+        range_cursor& operator++() {
+            Node *node{stack[--depth]};
+            pushLeftSpine(node->right);
+            return *this;
+        }
+
+        range_cursor operator++(int) {
+            range_cursor result{*this};
+            ++*this;
+            return result;
+        }
+
+        friend bool operator==(const range_cursor& lhs, const range_cursor& rhs) {
+            return lhs.current() == rhs.current();
+        }
+
+        friend bool operator!=(const range_cursor& lhs, const range_cursor& rhs) {
+            return lhs.current() != rhs.current();
+        }
+    private:
+        friend class AVL;
+
+        /**
+         * @param stop first node past the range, nullptr if the range reaches the largest key.
+         */
+        explicit range_cursor(Node *stop): stop{stop} {}
+
+        /**
+         * @param node root of a subtree whose keys are all in order after the popped ones.
+         */
+        void pushLeftSpine(Node *node) {
+            for (; node; node = node->left) {
+                stack[depth++] = node;
+            }
+
+            stopAtEnd();
+        }
+
+        /**
+         * Empties the stack once the next key is past the range.
+         */
+        void stopAtEnd() {
+            if (depth and stack[depth - 1] == stop) {
+                depth = 0;
+            }
+        }
+
+        /**
+         * @return node of the next key, nullptr once the range is exhausted.
+         */
+        [[nodiscard]] Node* current() const {
+            return depth ? stack[depth - 1] : nullptr;
+        }
+
+        // Nodes whose key & right subtree are still to be visited, the next key on top.
+        Node *stack[max_height]{};
+        size_type depth{0};
+
+        // First node past the range.
+        Node *stop{nullptr};
+    };
+
+    /**
+     * Lazy view of the keys in [low, high], computed when iterated over.
+     * It stays valid as long as the tree is not modified.
+     */
+    class range_view {
+    public:
+        /**
+         * @return cursor to the first key of the range, found in O(log n).
+         */
+        [[nodiscard]] range_cursor begin() const {
+            return first;
+        }
+
+        /**
+         * @return cursor past the last key of the range.
+         */
+        [[nodiscard]] range_cursor end() const {
+            return range_cursor(stop);
+        }
+
+        /**
+         * @return true if no key is in the range.
+         */
+        [[nodiscard]] bool empty() const {
+            return first == end();
+        }
+    private:
+        friend class AVL;
+
+        /**
+         * @param first cursor to the first key of the range.
+         * @param stop first node past the range.
+         */
+        range_view(const range_cursor& first, Node *stop): first{first}, stop{stop} {}
+
+        // Cursor to the first key of the range.
+        range_cursor first;
+
+        // First node past the range, nullptr if the range reaches the largest key.
+        Node *stop;
+    };
+
+    /**
+     * Owning handle to a node extracted from a tree.
+     * The node can be inserted into another tree with an equal allocator without any allocation,
+     * & its key can be modified in between. Destroys the node if it is never inserted.
+     */
+    class node_type {
+    public:
+        node_type() = default;
+
+        node_type(node_type&& other) noexcept:
+            node{std::exchange(other.node, nullptr)}, node_allocator{std::move(other.node_allocator)} {}
+
+        node_type& operator=(node_type&& other) noexcept {
+            if (this != &other) {
+                reset();
+                node = std::exchange(other.node, nullptr);
+                node_allocator = std::move(other.node_allocator);
+            }
+
+            return *this;
+        }
+
+        ~node_type() {
+            reset();
+        }
+
+        /**
+         * @return true if the handle does not own a node.
+         */
+        [[nodiscard]] bool empty() const noexcept {
+            return not node;
+        }
+
+        explicit operator bool() const noexcept {
+            return node;
+        }
+
+        /**
+         * @return the key stored in the owned node, which must exist.
+         */
+        T& value() const {
+            return node->key;
+        }
+
+        /**
+         * @return copy of the allocator of the owned node, which must exist.
+         */
+        allocator_type get_allocator() const {
+            return allocator_type(*node_allocator);
+        }
+    private:
+        friend class AVL;
+
+        /**
+         * @param node owned by the handle, unlinked from its tree.
+         * @param alloc allocator the node was allocated with.
+         */
+        node_type(Node *node, const NodeAllocator& alloc): node{node}, node_allocator{alloc} {}
+
+        /**
+         * Destroys the owned node, if any.
+         */
+        void reset() {
+            if (node) {
+                NodeTraits::destroy(*node_allocator, node);
+                NodeTraits::deallocate(*node_allocator, node, 1);
+                node = nullptr;
+            }
+        }
+
+        // Owned node, nullptr if empty.
+        Node *node{nullptr};
+
+        // Allocator of the owned node.
+        std::optional<NodeAllocator> node_allocator{};
+    };
+
+    /**
+     * Result of inserting a node handle.
+     * If the key was already present, node still owns the rejected node.
+     */
+    struct insert_return_type {
+        iterator position;
+        bool inserted;
+        node_type node;
+    };
+
+    /**
+     * Constructs an empty tree with a default constructed allocator.
+     */
+    AVL() = default;
+
+    /**
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes of the tree.
+     */
+    explicit AVL(const Compare& comp, const Allocator& alloc = Allocator()):
+        comparator{comp}, node_allocator{linkedAllocator(alloc)} {}
+
+    /**
+     * @param alloc allocator used for the nodes of the tree.
+     */
+    explicit AVL(const Allocator& alloc): node_allocator{linkedAllocator(alloc)} {}
+
+    /**
+     * Builds a perfectly balanced tree in O(n), without any comparison or rotation.
+     * With a slab allocator such as PoolAllocator, all the nodes come from one contiguous block.
+     *
+     * @param first start of the values, strictly increasing under comp.
+     * @param last end of the values.
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes of the tree.
+     */
+    template <typename ForwardIt>
+    AVL(sorted_unique_t, ForwardIt first, ForwardIt last,
+        const Compare& comp = Compare(), const Allocator& alloc = Allocator()):
+        comparator{comp}, node_allocator{linkedAllocator(alloc)} {
+        buildFromSorted(first, last);
+    }
+
+    /**
+     * Clones the other tree node for node, keeping its shape, in O(n) without any comparison.
+     * With a slab allocator, all the nodes come from one contiguous block, in key order.
+     *
+     * @param other tree to be copied.
+     */
+    AVL(const AVL& other):
+        AVL(other, allocator_type(NodeTraits::select_on_container_copy_construction(other.node_allocator))) {}
+
+    /**
+     * @param other tree to be copied.
+     * @param alloc allocator used for the nodes of the copy.
+     */
+    AVL(const AVL& other, const Allocator& alloc): comparator{other.comparator}, node_allocator{linkedAllocator(alloc)} {
+        copyFrom(other);
+    }
+
+    /**
+     * Takes the nodes of the other tree in O(1), leaving it empty & usable.
+     *
+     * @param other tree to be moved.
+     */
+    AVL(AVL&& other) noexcept:
+        comparator{std::move(other.comparator)}, node_allocator{other.node_allocator},
+        root{std::exchange(other.root, nullptr)} {}
+
+    /**
+     * @param other tree to be copied, replacing the keys of this tree.
+     * @return reference to this tree.
+     */
+    AVL& operator=(const AVL& other) {
+        if (this != &other) {
+            AVL copy(other, NodeTraits::propagate_on_container_copy_assignment::value ?
+                            other.get_allocator() : get_allocator());
+            clear();
+            comparator = copy.comparator;
+            node_allocator = copy.node_allocator;
+            root = std::exchange(copy.root, nullptr);
+        }
+
+        return *this;
+    }
+
+    /**
+     * Takes the nodes of the other tree in O(1) if the allocator propagates or both allocators are equal,
+     * otherwise the keys are copied into nodes of this allocator, in O(n).
+     *
+     * @param other tree to be moved, left empty.
+     * @return reference to this tree.
+     */
+    AVL& operator=(AVL&& other) noexcept(NodeTraits::propagate_on_container_move_assignment::value or
+                                         NodeTraits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+
+        clear();
+        comparator = std::move(other.comparator);
+
+        if constexpr (NodeTraits::propagate_on_container_move_assignment::value) {
+            node_allocator = other.node_allocator;
+        } else if (node_allocator != other.node_allocator) {
+            copyFrom(other);
+            other.clear();
+            return *this;
+        }
+
+        root = std::exchange(other.root, nullptr);
+
+        return *this;
+    }
+
+    ~AVL() {
+        clear();
+    }
+
+    /**
+     * @param first start of the values, strictly increasing under comp.
+     * @param last end of the values.
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes of the tree.
+     * @return a perfectly balanced tree holding the values, built in O(n).
+     */
+    template <typename ForwardIt>
+    [[nodiscard]] static AVL build_from_sorted(ForwardIt first, ForwardIt last,
+                                               const Compare& comp = Compare(),
+                                               const Allocator& alloc = Allocator()) {
+        return AVL(sorted_unique, first, last, comp, alloc);
+    }
+
+    /**
+     * Parallel build_from_sorted(), the storage is allocated up-front by the calling thread,
+     * then both halves of every range are constructed & linked on the pool.
+     *
+     * @param first start of the values, strictly increasing under comp.
+     * @param last end of the values.
+     * @param pool to run the construction on.
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes of the tree.
+     * @return a perfectly balanced tree holding the values.
+     */
+    template <typename RandomIt>
+    [[nodiscard]] static AVL build_from_sorted(RandomIt first, RandomIt last, WorkStealingPool& pool,
+                                               const Compare& comp = Compare(),
+                                               const Allocator& alloc = Allocator()) {
+        AVL result(comp, alloc);
+        result.buildFromSorted(first, last, pool);
+        return result;
+    }
+
+    /**
+     * @return copy of the ordering of the keys.
+     */
+    [[nodiscard]] key_compare key_comp() const {
+        return comparator;
+    }
+
+    /**
+     * @return copy of the allocator used by the tree.
+     */
+    [[nodiscard]] allocator_type get_allocator() const {
+        return allocator_type(node_allocator);
+    }
+
+    /**
+     * @param value to be inserted into the AVL tree, copied only if it is not present.
+     * @return iterator to the value in the tree, & true if it was inserted.
+     */
+    [[maybe_unused]] std::pair<iterator, bool> insert(const T& value) {
+        const auto [node, inserted] = insertNode(value, [&] { return createNode(value); });
+        return {iterator(node, this), inserted};
+    }
+
+    /**
+     * @param value to be inserted into the AVL tree, moved only if it is not present.
+     * @return iterator to the value in the tree, & true if it was inserted.
+     */
+    [[maybe_unused]] std::pair<iterator, bool> insert(T&& value) {
+        const auto [node, inserted] = insertNode(value, [&] { return createNode(std::move(value)); });
+        return {iterator(node, this), inserted};
+    }
+
+    /**
+     * @param value first value to be inserted
+     * @param next second value to be inserted
+     * @param values rest of the value to be inserted
+     */
+    template <typename ...Args>
+    [[maybe_unused]] void insert(const T& value, const T& next, const Args&... values) {
+        insert(value);
+        insert(next, values...);
+    }
+
+    /**
+     * Builds the value directly inside a new node.
+     * The node is discarded if an equivalent value is already present.
+     *
+     * @param args forwarded to the constructor of T.
+     * @return iterator to the value in the tree, & true if it was inserted.
+     */
+    template <typename ...Args>
+    [[maybe_unused]] std::pair<iterator, bool> emplace(Args&&... args) {
+        Node *created{createNode(std::forward<Args>(args)...)};
+        const auto [node, inserted] = insertNode(created->key, [created] { return created; });
+
+        if (not inserted) {
+            destroyNode(created);
+        }
+
+        return {iterator(node, this), inserted};
+    }
+
+    /**
+     * Starts the search for the insertion point at the hint rather than at the root.
+     * With parent links, it only climbs from the hint as far as needed before descending,
+     * in O(log d) for a value d keys away from the hint, and the rebalancing climbs back from the new leaf.
+     * Near-sorted input inserted at the position of the previous insertion is amortized O(1) per value,
+     * unless subtree sizes or summaries have to be updated up to the root.
+     * Without parent links, the hint is ignored & the insertion descends from the root.
+     *
+     * @param hint position close to the value, end() to start from the largest key.
+     * @param value to be inserted into the AVL tree, copied only if it is not present.
+     * @return iterator to the value in the tree.
+     */
+    [[maybe_unused]] iterator insert(const_iterator hint, const T& value) {
+        return iterator(insertNear(hint.node, value, [&] { return createNode(value); }).first, this);
+    }
+
+    /**
+     * Starts the search for the insertion point at the hint, see insert(const_iterator, const T&).
+     *
+     * @param hint position close to the value, end() to start from the largest key.
+     * @param value to be inserted into the AVL tree, moved only if it is not present.
+     * @return iterator to the value in the tree.
+     */
+    [[maybe_unused]] iterator insert(const_iterator hint, T&& value) {
+        return iterator(insertNear(hint.node, value, [&] { return createNode(std::move(value)); }).first, this);
+    }
+
+    /**
+     * Builds the value directly inside a new node, & links it starting at the hint,
+     * see insert(const_iterator, const T&). The node is discarded if an equivalent value is already present.
+     *
+     * @param hint position close to the value, end() to start from the largest key.
+     * @param args forwarded to the constructor of T.
+     * @return iterator to the value in the tree.
+     */
+    template <typename ...Args>
+    [[maybe_unused]] iterator emplace_hint(const_iterator hint, Args&&... args) {
+        Node *created{createNode(std::forward<Args>(args)...)};
+        const auto [node, inserted] = insertNear(hint.node, created->key, [created] { return created; });
+
+        if (not inserted) {
+            destroyNode(created);
+        }
+
+        return iterator(node, this);
+    }
+
+    /**
+     * Links the node owned by the handle into the tree, without any allocation.
+     * The handle must come from a tree with an equal allocator.
+     *
+     * @param handle to be inserted, emptied if its node is inserted.
+     * @return position of the key, whether it was inserted, & the handle if it was not.
+     */
+    [[maybe_unused]] insert_return_type insert(node_type&& handle) {
+        if (handle.empty()) {
+            return {end(), false, node_type()};
+        }
+
+        // the key may have been modified since the extraction
+        updateFields(handle.node);
+
+        const auto [node, inserted] = insertNode(handle.node->key, [&] { return std::exchange(handle.node, nullptr); });
+
+        if (not inserted) {
+            return {iterator(node, this), false, std::move(handle)};
+        }
+
+        return {iterator(node, this), true, node_type()};
+    }
+
+    /**
+     * @param value key of the node to be unlinked from the tree.
+     * @return handle owning the node, empty if the value is not present.
+     */
+    [[maybe_unused]] node_type extract(const T& value) {
+        return extractHandle(value);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param key equivalent to the key of the node to be unlinked from the tree.
+     * @return handle owning the node, empty if no equivalent key is present.
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[maybe_unused]] node_type extract(const K& key) {
+        return extractHandle(key);
+    }
+
+    /**
+     * With parent links, the node is unlinked in place & the tree rebalanced bottom-up, without any comparison.
+     * Without them, the key of the node is looked up from the root, in O(log n).
+     *
+     * @param position of the node to be unlinked from the tree, must be dereferenceable.
+     * @return handle owning the node.
+     */
+    [[maybe_unused]] node_type extract(const_iterator position) {
+        if constexpr (NodePolicy::parent_links) {
+            return node_type(unlinkAt(position.node), node_allocator);
+        } else {
+            return extractHandle(*position);
+        }
+    }
+
+    /**
+     * Inserts a batch of values by splitting the tree around them & joining the pieces back,
+     * in O(k log(n / k + 1)) for k values instead of O(k log n).
+     *
+     * @param first start of the batch, which is sorted in place.
+     * @param last end of the batch.
+     * @return number of values that were inserted, duplicates being skipped.
+     */
+    template <typename RandomIt>
+    [[maybe_unused]] size_type insert_batch(RandomIt first, RandomIt last) {
+        std::sort(first, last, comparator);
+
+        // nodes are built up-front, the merge itself never allocates
+        std::vector<Node*> nodes;
+        nodes.reserve(static_cast<std::size_t>(std::distance(first, last)));
+
+        try {
+            for (auto it{first}; it != last; ++it) {
+                if (nodes.empty() or comparator(nodes.back()->key, *it)) {
+                    nodes.push_back(createNode(*it));
+                }
+            }
+        } catch (...) {
+            for (Node *node: nodes) {
+                destroyNode(node);
+            }
+
+            throw;
+        }
+
+        size_type inserted{0};
+        setRoot(insertSorted(root, nodes.data(), nodes.data() + nodes.size(), inserted));
+        checkInvariants();
+
+        return inserted;
+    }
+
+    /**
+     * Removes a batch of values by splitting the tree around them & joining the pieces back,
+     * in O(k log(n / k + 1)) for k values instead of O(k log n).
+     *
+     * @param first start of the batch, which is sorted in place.
+     * @param last end of the batch.
+     * @return number of values that were present & removed.
+     */
+    template <typename RandomIt>
+    [[maybe_unused]] size_type erase_batch(RandomIt first, RandomIt last) {
+        std::sort(first, last, comparator);
+
+        size_type erased{0};
+        setRoot(eraseSorted(root, first, last, erased));
+        checkInvariants();
+
+        return erased;
+    }
+
+    /**
+     * Joins two trees around a new pivot in O(log n), without comparing any key.
+     * Both trees are emptied, their nodes move to the result. Their allocators must be equal.
+     *
+     * @param left tree whose keys all come before the pivot.
+     * @param pivot value to be inserted between the two trees.
+     * @param right tree whose keys all come after the pivot.
+     * @return tree holding the keys of left, the pivot & the keys of right.
+     */
+    [[nodiscard]] static AVL join(AVL&& left, const T& pivot, AVL&& right) {
+        assert(left.get_allocator() == right.get_allocator());
+
+        AVL result(left.comparator, left.get_allocator());
+        Node *node{result.createNode(pivot)};
+
+        result.setRoot(join(std::exchange(left.root, nullptr), node, std::exchange(right.root, nullptr)));
+        result.checkInvariants();
+
+        return result;
+    }
+
+    /**
+     * Concatenates two trees in O(log n), without comparing any key.
+     * Both trees are emptied, their nodes move to the result. Their allocators must be equal.
+     *
+     * @param left tree whose keys all come before the keys of right.
+     * @param right tree.
+     * @return tree holding the keys of left & right.
+     */
+    [[nodiscard]] static AVL join(AVL&& left, AVL&& right) {
+        assert(left.get_allocator() == right.get_allocator());
+
+        AVL result(left.comparator, left.get_allocator());
+        result.setRoot(join2(std::exchange(left.root, nullptr), std::exchange(right.root, nullptr)));
+        result.checkInvariants();
+
+        return result;
+    }
+
+    /**
+     * Splits the tree in O(log n).
+     *
+     * @param key moved to the returned tree along with the keys after it, if present.
+     * @return tree holding the keys not before key, only the keys before it stay in this tree.
+     */
+    [[nodiscard]] AVL split(const T& key) {
+        return splitTree(key);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param key moved to the returned tree along with the keys after it, if an equivalent is present.
+     * @return tree holding the keys not before key, only the keys before it stay in this tree.
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] AVL split(const K& key) {
+        return splitTree(key);
+    }
+
+    /**
+     * Moves the keys of other missing from this tree into it, in O(m log(n / m + 1)) for m <= n.
+     * The other tree is emptied & the duplicates are destroyed. The allocators must be equal.
+     *
+     * @param other tree to be merged.
+     */
+    [[maybe_unused]] void set_union(AVL&& other) {
+        assert(get_allocator() == other.get_allocator());
+
+        SequentialExecutor executor{*this};
+        setRoot(unionOf(root, std::exchange(other.root, nullptr), executor));
+        checkInvariants();
+    }
+
+    /**
+     * Parallel set_union(), the two sides of each split are merged on the pool.
+     * The comparator must be safe to call concurrently.
+     *
+     * @param other tree to be merged.
+     * @param pool to run the recursion on.
+     */
+    [[maybe_unused]] void set_union(AVL&& other, WorkStealingPool& pool) {
+        assert(get_allocator() == other.get_allocator());
+
+        ParallelExecutor executor{*this, pool};
+        pool.run([&] { setRoot(unionOf(root, std::exchange(other.root, nullptr), executor)); });
+        checkInvariants();
+    }
+
+    /**
+     * Keeps only the keys also present in other, in O(m log(n / m + 1)) for m <= n.
+     * The other tree is emptied & every dropped node is destroyed. The allocators must be equal.
+     *
+     * @param other tree to be intersected with.
+     */
+    [[maybe_unused]] void set_intersection(AVL&& other) {
+        assert(get_allocator() == other.get_allocator());
+
+        SequentialExecutor executor{*this};
+        setRoot(intersectionOf(root, std::exchange(other.root, nullptr), executor));
+        checkInvariants();
+    }
+
+    /**
+     * Parallel set_intersection(), the two sides of each split are intersected on the pool.
+     * The comparator must be safe to call concurrently.
+     *
+     * @param other tree to be intersected with.
+     * @param pool to run the recursion on.
+     */
+    [[maybe_unused]] void set_intersection(AVL&& other, WorkStealingPool& pool) {
+        assert(get_allocator() == other.get_allocator());
+
+        ParallelExecutor executor{*this, pool};
+        pool.run([&] { setRoot(intersectionOf(root, std::exchange(other.root, nullptr), executor)); });
+        checkInvariants();
+    }
+
+    /**
+     * Removes the keys present in other, in O(m log(n / m + 1)) for m <= n.
+     * The other tree is emptied & every dropped node is destroyed. The allocators must be equal.
+     *
+     * @param other tree whose keys are to be removed.
+     */
+    [[maybe_unused]] void set_difference(AVL&& other) {
+        assert(get_allocator() == other.get_allocator());
+
+        SequentialExecutor executor{*this};
+        setRoot(differenceOf(root, std::exchange(other.root, nullptr), executor));
+        checkInvariants();
+    }
+
+    /**
+     * Parallel set_difference(), the two sides of each split are processed on the pool.
+     * The comparator must be safe to call concurrently.
+     *
+     * @param other tree whose keys are to be removed.
+     * @param pool to run the recursion on.
+     */
+    [[maybe_unused]] void set_difference(AVL&& other, WorkStealingPool& pool) {
+        assert(get_allocator() == other.get_allocator());
+
+        ParallelExecutor executor{*this, pool};
+        pool.run([&] { setRoot(differenceOf(root, std::exchange(other.root, nullptr), executor)); });
+        checkInvariants();
+    }
+
+    /**
+     * @param value to be deleted from the AVL tree, if present.
+     * @return true if the value was present & removed.
+     */
+    [[maybe_unused]] bool remove(const T& value) {
+        return removeNode(value);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param key equivalent to the value to be deleted from the AVL tree, if present.
+     * @return true if a value was present & removed.
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[maybe_unused]] bool remove(const K& key) {
+        return removeNode(key);
+    }
+
+    /**
+     * @param value to be searched for in the AVL tree.
+     * @return nullptr if the value does not exist in the tree.
+     *         Otherwise, a pointer to the node having the value.
+     */
+    [[maybe_unused]] Node* search(const T& value) const {
+        return search(root, value);
+    }
+
+    /**
+     * Only available with a transparent comparator, no temporary T is built.
+     *
+     * @param key equivalent to the value to be searched for in the AVL tree.
+     * @return nullptr if no equivalent value exists in the tree.
+     *         Otherwise, a pointer to the node having the value.
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[maybe_unused]] Node* search(const K& key) const {
+        return search(root, key);
+    }
+
+    /**
+     * Searches for a batch of keys with interleaved descents, hiding the cache misses of each one behind the others.
+     * Up to batch_group descents are in flight, each advances one level per round & prefetches its next node,
+     * which is loaded while the other descents take their step. A finished descent is replaced by the next key.
+     *
+     * @param first start of the keys, T or keys the comparator accepts.
+     * @param last end of the keys.
+     * @param out start of the results, out[i] is set to the node holding first[i], nullptr if absent.
+     */
+    template <typename RandomIt, typename OutputIt>
+    [[maybe_unused]] void search_batch(RandomIt first, RandomIt last, OutputIt out) const {
+        const auto count{static_cast<std::size_t>(std::distance(first, last))};
+        BatchLookup group[batch_group];
+        std::size_t active{0};
+        std::size_t next{0};
+
+        for (; active < batch_group and next < count; active++, next++) {
+            group[active] = {next, root, nullptr, 0};
+        }
+
+        while (active) {
+            for (std::size_t i{0}; i < active;) {
+                auto& lookup{group[i]};
+                const auto& key{first[lookup.index]};
+
+                if (Node *node{lookup.node}) {
+                    if constexpr (instrumented) {
+                        lookup.depth++;
+                    }
+
+                    // one comparison per level, equality is only checked against the last candidate
+                    if (comparator(node->key, key)) {
+                        node = node->right;
+                    } else {
+                        lookup.candidate = node;
+                        node = node->left;
+                    }
+
+                    prefetchNode(node);
+                    lookup.node = node;
+                    i++;
+                    continue;
+                }
+
+                Node *candidate{lookup.candidate};
+                out[lookup.index] = candidate and not comparator(key, candidate->key) ? candidate : nullptr;
+                recordSearch(lookup.depth);
+
+                if (next < count) {
+                    lookup = {next++, root, nullptr, 0};
+                    i++;
+                } else {
+                    // the last descent takes the free slot & steps next
+                    lookup = group[--active];
+                }
+            }
+        }
+    }
+
+    /**
+     * Finger search, starting at a previously returned position rather than at the root.
+     * With parent links, it only climbs from the finger as far as needed before descending,
+     * in O(log d) for a value d keys away from the finger.
+     * Without parent links, the search descends from the root.
+     *
+     * @param finger position close to the value, end() to start from the largest key.
+     * @param value to be searched for in the AVL tree.
+     * @return iterator to the value, end() if it does not exist in the tree.
+     */
+    [[nodiscard]] iterator search_from(const_iterator finger, const T& value) const {
+        return iterator(search(fingerStart(finger.node, value), value), this);
+    }
+
+    /**
+     * Only available with a transparent comparator, see search_from(const_iterator, const T&).
+     *
+     * @param finger position close to the key, end() to start from the largest key.
+     * @param key equivalent to the value to be searched for in the AVL tree.
+     * @return iterator to the value, end() if no equivalent value exists in the tree.
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] iterator search_from(const_iterator finger, const K& key) const {
+        return iterator(search(fingerStart(finger.node, key), key), this);
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return iterator to the first key not before value, end() if there is none.
+     */
+    [[nodiscard]] iterator lower_bound(const T& value) const {
+        return iterator(boundNode(value, false), this);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param key bound of the search.
+     * @return iterator to the first key not before key, end() if there is none.
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] iterator lower_bound(const K& key) const {
+        return iterator(boundNode(key, false), this);
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return iterator to the first key after value, end() if there is none.
+     */
+    [[nodiscard]] iterator upper_bound(const T& value) const {
+        return iterator(boundNode(value, true), this);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param key bound of the search.
+     * @return iterator to the first key after key, end() if there is none.
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] iterator upper_bound(const K& key) const {
+        return iterator(boundNode(key, true), this);
+    }
+
+    /**
+     * @param value to search for.
+     * @return the range of keys equivalent to value, empty if there is none.
+     */
+    [[nodiscard]] std::pair<iterator, iterator> equal_range(const T& value) const {
+        return {lower_bound(value), upper_bound(value)};
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param key to search for.
+     * @return the range of keys equivalent to key, empty if there is none.
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] std::pair<iterator, iterator> equal_range(const K& key) const {
+        return {lower_bound(key), upper_bound(key)};
+    }
+
+    /**
+     * @param low smallest key of the range, need not be present.
+     * @param high largest key of the range, need not be present.
+     * @return lazy view of the keys in [low, high].
+     */
+    [[nodiscard]] range_view range(const T& low, const T& high) const {
+        return rangeOf(low, high);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param low smallest key of the range, need not be present.
+     * @param high largest key of the range, need not be present.
+     * @return lazy view of the keys in [low, high].
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] range_view range(const K& low, const K& high) const {
+        return rangeOf(low, high);
+    }
+
+    /**
+     * @return iterator to the smallest key.
+     */
+    [[nodiscard]] iterator begin() const {
+        return iterator(minimum(root), this);
+    }
+
+    /**
+     * @return iterator past the largest key.
+     */
+    [[nodiscard]] iterator end() const {
+        return iterator(nullptr, this);
+    }
+
+    [[nodiscard]] iterator cbegin() const {
+        return begin();
+    }
+
+    [[nodiscard]] iterator cend() const {
+        return end();
+    }
+
+    /**
+     * @return reverse iterator to the largest key.
+     */
+    [[nodiscard]] reverse_iterator rbegin() const {
+        return reverse_iterator(end());
+    }
+
+    /**
+     * @return reverse iterator past the smallest key.
+     */
+    [[nodiscard]] reverse_iterator rend() const {
+        return reverse_iterator(begin());
+    }
+
+    /**
+     * @return pointer to the root node.
+     */
+    [[maybe_unused]] inline Node* getRoot() const {
+        return root;
+    }
+
+    /**
+     * @param node pointer to a node in the tree.
+     * @return the height of the node. If nullptr, returns 0.
+     */
+    static size_type height(Node *node) {
+        return node ? node->height : 0;
+    }
+
+    /**
+     * @return the height of the tree.
+     */
+    [[nodiscard]] size_type height() const {
+        return height(root);
+    }
+
+    /**
+     * @return true if the tree holds no key.
+     */
+    [[nodiscard]] bool empty() const {
+        return not root;
+    }
+
+    /**
+     * Checks the invariants of the tree in O(n): strict key order, exact heights, AVL balance,
+     * and the parent links & subtree sizes when the node policy stores them.
+     *
+     * @return true if every invariant holds.
+     */
+    [[nodiscard]] bool validate() const {
+        return 0 <= validateSubtree(root, nullptr, nullptr, nullptr, 0);
+    }
+
+    /**
+     * Destroys every node in O(n) time & O(1) space, without recursion.
+     * Trivially destructible nodes in an arena PoolAllocator are dropped in O(1),
+     * their memory being reclaimed with the arena.
+     */
+    void clear() noexcept {
+        if constexpr (std::is_trivially_destructible_v<Node> and std::is_same_v<NodeAllocator, PoolAllocator<Node>>) {
+            if (node_allocator.resource()->mode() == NodePool::Mode::Arena) {
+                root = nullptr;
+                return;
+            }
+        }
+
+        destroySubtree(std::exchange(root, nullptr));
+    }
+
+    /**
+     * @return number of keys in the tree, in O(1) with a node policy counting subtree sizes,
+     *         O(n) otherwise.
+     */
+    [[nodiscard]] size_type size() const {
+        return subtreeSize(root);
+    }
+
+    /**
+     * Needs an InstrumentedAllocator, without one the tree records nothing & costs nothing.
+     * The counters are shared by every tree using a copy of the same allocator.
+     *
+     * @return snapshot of the rotation, search depth & memory counters.
+     */
+    [[nodiscard]] TreeStatisticsSnapshot stats() const {
+        static_assert(instrumented, "stats() needs an InstrumentedAllocator");
+        return node_allocator.statistics()->snapshot();
+    }
+
+    /**
+     * Needs a node policy counting subtree sizes, such as OrderStatisticNodePolicy.
+     *
+     * @param value whose rank is computed, need not be present.
+     * @return number of keys before value, in O(log n).
+     */
+    [[nodiscard]] size_type rank(const T& value) const {
+        return countBefore(value, false);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param key whose rank is computed, need not be present.
+     * @return number of keys before key, in O(log n).
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] size_type rank(const K& key) const {
+        return countBefore(key, false);
+    }
+
+    /**
+     * Needs a node policy counting subtree sizes, such as OrderStatisticNodePolicy.
+     *
+     * @param index zero-based position of the key in order.
+     * @return iterator to the key at index, in O(log n). end() if index is out of range.
+     */
+    [[nodiscard]] iterator select(size_type index) const {
+        static_assert(counted, "order statistics need a node policy with a subtree_size_type");
+
+        Node *current{root};
+
+        while (current) {
+            const auto left_size{subtreeSize(current->left)};
+
+            if (index < left_size) {
+                current = current->left;
+            } else if (index == left_size) {
+                break;
+            } else {
+                index -= left_size + 1;
+                current = current->right;
+            }
+        }
+
+        return iterator(current, this);
+    }
+
+    /**
+     * Needs a node policy counting subtree sizes, such as OrderStatisticNodePolicy.
+     *
+     * @param low smallest key counted, need not be present.
+     * @param high largest key counted, need not be present.
+     * @return number of keys in [low, high], in O(log n).
+     */
+    [[nodiscard]] size_type count_range(const T& low, const T& high) const {
+        return countRange(low, high);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param low smallest key counted, need not be present.
+     * @param high largest key counted, need not be present.
+     * @return number of keys in [low, high], in O(log n).
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] size_type count_range(const K& low, const K& high) const {
+        return countRange(low, high);
+    }
+
+    /**
+     * Copies the keys into a contiguous read-only snapshot, searched without chasing pointers.
+     * The tree itself is left untouched & can keep buffering writes.
+     *
+     * @return frozen copy of the tree, in O(n).
+     */
+    [[nodiscard]] FrozenAVL<T, Compare> freeze() const {
+        return FrozenAVL<T, Compare>(begin(), static_cast<std::size_t>(size()), comparator);
+    }
+
+    /**
+     * Writes the keys as a read-only image, which MappedAVL can search in place.
+     * Needs trivially copyable keys, the image is only readable on the same platform.
+     * A stream is written in order, which costs one in-order pass per level past the top ones,
+     * see writeAvlImage(): ten times slower than save(path) for 10 million int keys, which makes one pass.
+     *
+     * @param out binary output stream receiving the image.
+     * @throws runtime_error if the stream fails.
+     */
+    void save(std::ostream& out) const {
+        static_assert(std::is_trivially_copyable_v<T>, "save() needs trivially copyable keys");
+        writeAvlImage<T>(out, begin(), static_cast<std::size_t>(size()));
+    }
+
+    /**
+     * Writes the image in a single in-order pass, straight into the memory-mapped file where possible.
+     *
+     * @param path of the image file, replaced if it exists.
+     * @throws runtime_error if the file cannot be written.
+     */
+    void save(const std::string& path) const {
+        static_assert(std::is_trivially_copyable_v<T>, "save() needs trivially copyable keys");
+        writeAvlImageFile<T>(path, begin(), static_cast<std::size_t>(size()));
+    }
+
+    /**
+     * Needs a node policy with an augmentation, such as AugmentedNodePolicy.
+     *
+     * @return summary of every key of the tree, in O(1).
+     */
+    [[nodiscard]] auto aggregate() const {
+        static_assert(augmented, "aggregate() needs a node policy with an augmentation");
+        return subtreeSummary(root);
+    }
+
+    /**
+     * Needs a node policy with an augmentation, such as AugmentedNodePolicy.
+     *
+     * @param low smallest key summarized, need not be present.
+     * @param high largest key summarized, need not be present.
+     * @return summary of the keys in [low, high], in order, in O(log n).
+     */
+    [[nodiscard]] auto aggregate(const T& low, const T& high) const {
+        static_assert(augmented, "aggregate() needs a node policy with an augmentation");
+        return aggregateRange(root, low, high, false, false);
+    }
+
+    /**
+     * Only available with a transparent comparator.
+     *
+     * @param low smallest key summarized, need not be present.
+     * @param high largest key summarized, need not be present.
+     * @return summary of the keys in [low, high], in order, in O(log n).
+     */
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    [[nodiscard]] auto aggregate(const K& low, const K& high) const {
+        static_assert(augmented, "aggregate() needs a node policy with an augmentation");
+        return aggregateRange(root, low, high, false, false);
+    }
+private:
+    /*
+     * Ordering of the keys.
+     */
+    Compare comparator{};
+
+    /*
+     * Allocator for the nodes of the tree.
+     */
+    NodeAllocator node_allocator{linkedAllocator(Allocator())};
+
+    /*
+     * Node pointer to the root node of the tree.
+     */
+    Node *root{nullptr};
+
+    /**
+     * Bounds the pool of the allocator to the reach of the links, if the links are relative,
+     * so that no link between two nodes can overflow.
+     *
+     * @param alloc allocator given to the tree.
+     * @return the allocator rebound to the nodes.
+     * @throws length_error if the pool cannot keep its nodes within reach of each other.
+     */
+    static NodeAllocator linkedAllocator(const Allocator& alloc) {
+        NodeAllocator result(alloc);
+
+        if constexpr (relative_links) {
+            const auto span{std::min<std::uint64_t>(RelativeLink<Node>::reach, SIZE_MAX)};
+
+            if (not boundSlabSpan(result, sizeof(Node), alignof(Node), static_cast<std::size_t>(span))) {
+                throw std::length_error("AVL: the pool cannot keep relative links in reach");
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * @param args forwarded to the constructor of the key stored in the node.
+     * @return pointer to a new node allocated by the tree allocator.
+     */
+    template <typename ...Args>
+    Node* createNode(Args&&... args) {
+        Node *node{NodeTraits::allocate(node_allocator, 1)};
+
+        try {
+            NodeTraits::construct(node_allocator, node, std::in_place, std::forward<Args>(args)...);
+        } catch (...) {
+            NodeTraits::deallocate(node_allocator, node, 1);
+            throw;
+        }
+
+        return node;
+    }
+
+    /**
+     * @param node to be destroyed & returned to the tree allocator.
+     */
+    void destroyNode(Node *node) {
+        NodeTraits::destroy(node_allocator, node);
+        NodeTraits::deallocate(node_allocator, node, 1);
+    }
+
+    /**
+     * Destroys every node of the subtree in O(n) time & O(1) space.
+     *
+     * @param node root of the subtree.
+     */
+    void destroySubtree(Node *node) {
+        // right rotations flatten the subtree into a right spine, destroyed as it is walked
+        while (node) {
+            if (Node *left{node->left}) {
+                node->left = left->right;
+                left->right = node;
+                node = left;
+            } else {
+                Node *right{node->right};
+                destroyNode(node);
+                node = right;
+            }
+        }
+    }
+
+    /**
+     * Builds a balanced subtree from the next count values, in order.
+     * On exception, the nodes built so far are destroyed.
+     *
+     * @param first next value, advanced past the consumed values.
+     * @param count number of values to consume.
+     * @param makeNode returns a new node holding the given value.
+     * @return root of the subtree.
+     */
+    template <typename ForwardIt, typename MakeNode>
+    Node* buildSorted(ForwardIt& first, size_type count, MakeNode& makeNode) {
+        if (not count) {
+            return nullptr;
+        }
+
+        // the right half gets the extra node, subtree heights differ by at most one
+        const size_type left_count{(count - 1) / 2};
+        Node *left{buildSorted(first, left_count, makeNode)};
+        Node *node;
+
+        try {
+            node = makeNode(*first);
+        } catch (...) {
+            destroySubtree(left);
+            throw;
+        }
+
+        assert(not left or comparator(maximum(left)->key, node->key));
+
+        ++first;
+        setLeft(node, left);
+
+        try {
+            setRight(node, buildSorted(first, count - 1 - left_count, makeNode));
+        } catch (...) {
+            destroySubtree(node);
+            throw;
+        }
+
+        updateNode(node);
+
+        return node;
+    }
+
+    /**
+     * @param node root of the subtree to be checked, may be nullptr.
+     * @param parent expected parent of the node.
+     * @param low key every key of the subtree must come after, nullptr for none.
+     * @param high key every key of the subtree must come before, nullptr for none.
+     * @param depth of the node, deeper than max_height means the links are corrupted.
+     * @return height of the subtree, -1 if an invariant is broken.
+     */
+    size_type validateSubtree(Node *node, Node *parent, const T *low, const T *high, size_type depth) const {
+        if (not node) {
+            return 0;
+        }
+
+        if (max_height < depth or (low and not comparator(*low, node->key)) or
+            (high and not comparator(node->key, *high))) {
+            return -1;
+        }
+
+        if constexpr (NodePolicy::parent_links) {
+            if (node->parent != parent) {
+                return -1;
+            }
+        }
+
+        const auto left{validateSubtree(node->left, node, low, &node->key, depth + 1)};
+        const auto right{validateSubtree(node->right, node, &node->key, high, depth + 1)};
+
+        if (left < 0 or right < 0 or 1 < left - right or 1 < right - left or height(node) != 1 + std::max(left, right)) {
+            return -1;
+        }
+
+        if constexpr (counted) {
+            if (static_cast<size_type>(node->size) != 1 + subtreeSize(node->left) + subtreeSize(node->right)) {
+                return -1;
+            }
+        }
+
+        return height(node);
+    }
+
+    /**
+     * With AVL_CHECK_INVARIANTS defined to 1, aborts as soon as a mutation leaves the tree invalid,
+     * in release builds as well, so that stress & fuzz runs stop at the faulty operation.
+     * Each check is O(n), the mode is meant for testing only.
+     */
+    void checkInvariants() const {
+#if AVL_CHECK_INVARIANTS
+        if (not validate()) {
+            std::cerr << "AVL: invariant broken after a mutation" << std::endl;
+            std::abort();
+        }
+#endif
+    }
+
+    /**
+     * Clones a subtree, keeping its shape. On exception, the nodes built so far are destroyed.
+     *
+     * @param source root of the subtree to be cloned, may be nullptr.
+     * @param makeNode builds a node holding a copy of a key.
+     * @return root of the clone.
+     */
+    template <typename MakeNode>
+    Node* cloneSubtree(const Node *source, MakeNode& makeNode) {
+        if (not source) {
+            return nullptr;
+        }
+
+        // in order, so slab nodes are laid out in key order
+        Node *left{cloneSubtree(source->left, makeNode)};
+        Node *node;
+
+        try {
+            node = makeNode(source->key);
+        } catch (...) {
+            destroySubtree(left);
+            throw;
+        }
+
+        setLeft(node, left);
+
+        try {
+            setRight(node, cloneSubtree(source->right, makeNode));
+        } catch (...) {
+            destroySubtree(node);
+            throw;
+        }
+
+        node->height = source->height;
+        updateFields(node);
+
+        return node;
+    }
+
+    /**
+     * Replaces the empty tree by a clone of the other tree.
+     *
+     * @param other tree to be copied.
+     */
+    void copyFrom(const AVL& other) {
+        if (not other.root) {
+            return;
+        }
+
+        if constexpr (is_slab_allocator<NodeAllocator>::value) {
+            // one contiguous block, whose nodes can still be freed one by one
+            const auto count{other.size()};
+            Node *block{NodeTraits::allocate(node_allocator, count)};
+            size_type used{0};
+
+            auto makeNode = [&](const T& key) {
+                Node *node{block + used};
+                NodeTraits::construct(node_allocator, node, std::in_place, key);
+                ++used;
+                return node;
+            };
+
+            try {
+                setRoot(cloneSubtree(other.root, makeNode));
+            } catch (...) {
+                NodeTraits::deallocate(node_allocator, block + used, count - used);
+                throw;
+            }
+        } else {
+            auto makeNode = [this](const T& key) {
+                return createNode(key);
+            };
+
+            setRoot(cloneSubtree(other.root, makeNode));
+        }
+
+        checkInvariants();
+    }
+
+    /**
+     * Replaces the empty tree by a balanced tree holding the values.
+     *
+     * @param first start of the values, strictly increasing.
+     * @param last end of the values.
+     */
+    template <typename ForwardIt>
+    void buildFromSorted(ForwardIt first, ForwardIt last) {
+        static_assert(
+            std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<ForwardIt>::iterator_category>,
+            "sorted construction needs forward iterators"
+        );
+
+        const auto count{static_cast<size_type>(std::distance(first, last))};
+
+        if (not count) {
+            return;
+        }
+
+        if constexpr (is_slab_allocator<NodeAllocator>::value) {
+            // one contiguous block, whose nodes can still be freed one by one
+            Node *block{NodeTraits::allocate(node_allocator, count)};
+            size_type used{0};
+
+            auto makeNode = [&](const auto& value) {
+                Node *node{block + used};
+                NodeTraits::construct(node_allocator, node, std::in_place, value);
+                ++used;
+                return node;
+            };
+
+            try {
+                root = buildSorted(first, count, makeNode);
+            } catch (...) {
+                NodeTraits::deallocate(node_allocator, block + used, count - used);
+                throw;
+            }
+        } else {
+            auto makeNode = [this](const auto& value) {
+                return createNode(value);
+            };
+
+            root = buildSorted(first, count, makeNode);
+        }
+
+        checkInvariants();
+    }
+
+    /*
+     * True if every node counts the nodes of its subtree.
+     */
+    static constexpr bool counted{not std::is_void_v<typename NodePolicy::subtree_size_type>};
+
+    /*
+     * True if every node summarizes the keys of its subtree.
+     */
+    static constexpr bool augmented{not std::is_void_v<typename NodePolicy::augmentation>};
+
+    /*
+     * True if the tree records its rotations, search depths & allocations, see stats().
+     */
+    static constexpr bool instrumented{is_instrumented_allocator<Allocator>::value};
+
+    /*
+     * True if the nodes are linked by 32-bit offsets, which only reach nodes of the same bounded pool.
+     */
+    static constexpr bool relative_links{
+        std::is_same_v<typename NodePolicy::template link_type<Node>, RelativeLink<Node>>
+    };
+
+    static_assert(not relative_links or is_slab_allocator<NodeAllocator>::value,
+                  "relative links need the nodes to come from a PoolAllocator");
+
+    /**
+     * @param node root of a subtree, may be nullptr.
+     * @return number of nodes in the subtree, in O(1) if they are counted, O(n) otherwise.
+     */
+    static size_type subtreeSize(Node *node) {
+        if constexpr (counted) {
+            return node ? static_cast<size_type>(node->size) : 0;
+        } else {
+            return node ? 1 + subtreeSize(node->left) + subtreeSize(node->right) : 0;
+        }
+    }
+
+    /**
+     * @param key T or a key the comparator accepts.
+     * @param inclusive true to count the keys equivalent to key as well.
+     * @return number of keys before key, or not after it if inclusive.
+     */
+    template <typename K>
+    size_type countBefore(const K& key, bool inclusive) const {
+        static_assert(counted, "order statistics need a node policy with a subtree_size_type");
+
+        size_type count{0};
+        Node *current{root};
+
+        while (current) {
+            if (inclusive ? not comparator(key, current->key) : comparator(current->key, key)) {
+                count += subtreeSize(current->left) + 1;
+                current = current->right;
+            } else {
+                current = current->left;
+            }
+        }
+
+        return count;
+    }
+
+    /**
+     * @param low T or a key the comparator accepts.
+     * @param high T or a key the comparator accepts.
+     * @return number of keys in [low, high].
+     */
+    template <typename K>
+    size_type countRange(const K& low, const K& high) const {
+        if (comparator(high, low)) {
+            return 0;
+        }
+
+        return countBefore(high, true) - countBefore(low, false);
+    }
+
+    /**
+     * @param node root of a subtree, may be nullptr.
+     * @return summary of the subtree, the identity if empty.
+     */
+    static auto subtreeSummary(Node *node) {
+        return node ? node->summary : NodePolicy::augmentation::identity();
+    }
+
+    /**
+     * Combines whole subtrees hanging off the two search paths of the bounds, in O(log n).
+     *
+     * @param node root of the subtree.
+     * @param low smallest key summarized, ignored if open_low.
+     * @param high largest key summarized, ignored if open_high.
+     * @param open_low true if every key of the subtree is known not to be before low.
+     * @param open_high true if every key of the subtree is known not to be after high.
+     * @return summary of the keys of the subtree in [low, high].
+     */
+    template <typename K>
+    auto aggregateRange(Node *node, const K& low, const K& high, bool open_low, bool open_high) const {
+        using Augmentation = typename NodePolicy::augmentation;
+
+        if (not node) {
+            return Augmentation::identity();
+        }
+
+        if (open_low and open_high) {
+            return node->summary;
+        }
+
+        if (not open_low and comparator(node->key, low)) {
+            return aggregateRange(node->right, low, high, open_low, open_high);
+        }
+
+        if (not open_high and comparator(high, node->key)) {
+            return aggregateRange(node->left, low, high, open_low, open_high);
+        }
+
+        // the node is in range, so is everything right of it on the left side & conversely
+        return Augmentation::combine(
+            Augmentation::combine(aggregateRange(node->left, low, high, open_low, true), Augmentation::lift(node->key)),
+            aggregateRange(node->right, low, high, true, open_high)
+        );
+    }
+
+    /**
+     * @tparam K type of the searched key, T or any type the comparator accepts.
+     * @return true if the comparator can order (K, T) pairs in a single three-way call.
+     */
+    template <typename K>
+    static constexpr bool threeWay() {
+        return has_three_way<Compare, K, T>::value;
+    }
+
+    /**
+     * @param node in the tree, nullptr for end().
+     * @return iterator to the node.
+     */
+    iterator iteratorTo(Node *node) const {
+        return iterator(node, this);
+    }
+
+    /**
+     * @param key T or a key the comparator accepts.
+     * @param after true to skip the keys equivalent to key as well.
+     * @return the first node not before key, or after it, nullptr if there is none.
+     */
+    template <typename K>
+    Node* boundNode(const K& key, bool after) const {
+        Node *result{nullptr};
+        Node *current{root};
+
+        while (current) {
+            if (after ? comparator(key, current->key) : not comparator(current->key, key)) {
+                result = current;
+                current = current->left;
+            } else {
+                current = current->right;
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * @param low T or a key the comparator accepts.
+     * @param high T or a key the comparator accepts.
+     * @return view of the keys in [low, high].
+     */
+    template <typename K>
+    range_view rangeOf(const K& low, const K& high) const {
+        if (comparator(high, low)) {
+            return range_view(range_cursor(nullptr), nullptr);
+        }
+
+        Node *stop{boundNode(high, true)};
+        range_cursor first(stop);
+
+        // the ancestors not before low are the ones the scan comes back to
+        for (Node *current{root}; current;) {
+            if (comparator(current->key, low)) {
+                current = current->right;
+            } else {
+                first.stack[first.depth++] = current;
+                current = current->left;
+            }
+        }
+
+        first.stopAtEnd();
+
+        return range_view(first, stop);
+    }
+
+    /**
+     * @param root to start the search from.
+     * @param value to search for in the AVL tree.
+     * @return nullptr if the value does not exist in the tree.
+     *         Otherwise, a pointer to the node having the value.
+     */
+    template <typename K>
+    Node* search(Node *root, const K& value) const {
+        [[maybe_unused]] std::size_t depth{0};
+
+        if constexpr (threeWay<K>()) {
+            while (root) {
+                if constexpr (instrumented) {
+                    depth++;
+                }
+
+                const auto order{comparator.compare(value, root->key)};
+
+                if (order == 0) {
+                    recordSearch(depth);
+                    return root;
+                }
+
+                root = order < 0 ? root->left : root->right;
+            }
+
+            recordSearch(depth);
+            return nullptr;
+        } else {
+            // one comparison per level, equality is only checked against the last candidate
+            Node *candidate{nullptr};
+
+            while (root) {
+                if constexpr (instrumented) {
+                    depth++;
+                }
+
+                if (comparator(root->key, value)) {
+                    root = root->right;
+                } else {
+                    candidate = root;
+                    root = root->left;
+                }
+            }
+
+            recordSearch(depth);
+            return candidate and not comparator(value, candidate->key) ? candidate : nullptr;
+        }
+    }
+
+    /**
+     * State of one descent of search_batch().
+     */
+    struct BatchLookup {
+        // Position of the key in the batch.
+        std::size_t index;
+
+        // Next node to compare with, nullptr once the descent reached a leaf.
+        Node *node;
+
+        // Last node the descent turned left at, the only one that can equal the key.
+        Node *candidate;
+
+        // Number of nodes visited, only counted if the tree is instrumented.
+        std::size_t depth;
+    };
+
+    /**
+     * Hints the processor to load the node into the cache, so that a later access does not stall.
+     *
+     * @param node to be loaded, nullptr for none.
+     */
+    static void prefetchNode([[maybe_unused]] const Node *node) {
+#if defined(__GNUC__)
+        if (node) {
+            __builtin_prefetch(node);
+        }
+#endif
+    }
+
+    /**
+     * @param depth number of nodes visited by a search, recorded if the tree is instrumented.
+     */
+    void recordSearch([[maybe_unused]] std::size_t depth) const {
+        if constexpr (instrumented) {
+            node_allocator.statistics()->record_search(depth);
+        }
+    }
+
+    /**
+     * @param child whose parent link is set, if the node policy has parent links.
+     * @param parent of the child.
+     */
+    static void setParent(Node *child, Node *parent) {
+        if constexpr (NodePolicy::parent_links) {
+            if (child) {
+                child->parent = parent;
+            }
+        }
+    }
+
+    /**
+     * @param node whose left child is set.
+     * @param child new left child, may be nullptr.
+     */
+    static void setLeft(Node *node, Node *child) {
+        node->left = child;
+        setParent(child, node);
+    }
+
+    /**
+     * @param node whose right child is set.
+     * @param child new right child, may be nullptr.
+     */
+    static void setRight(Node *node, Node *child) {
+        node->right = child;
+        setParent(child, node);
+    }
+
+    /**
+     * @param root of the subtree.
+     * @return the node with the smallest key in the subtree, nullptr if empty.
+     */
+    static Node* minimum(Node *root) {
+        if (root) {
+            while (root->left) {
+                root = root->left;
+            }
+        }
+
+        return root;
+    }
+
+    /**
+     * @param root of the subtree.
+     * @return the node with the largest key in the subtree, nullptr if empty.
+     */
+    static Node* maximum(Node *root) {
+        if (root) {
+            while (root->right) {
+                root = root->right;
+            }
+        }
+
+        return root;
+    }
+
+    /**
+     * @param node in the tree.
+     * @return the node with the next key in order, nullptr if node holds the largest key.
+     */
+    Node* successor(Node *node) const {
+        if (node->right) {
+            return minimum(node->right);
+        }
+
+        if constexpr (NodePolicy::parent_links) {
+            Node *parent{node->parent};
+
+            while (parent and node == parent->right) {
+                node = parent;
+                parent = parent->parent;
+            }
+
+            return parent;
+        } else {
+            // last ancestor the path to node turns left at
+            Node *result{nullptr};
+            Node *current{root};
+
+            while (current != node) {
+                if (comparator(node->key, current->key)) {
+                    result = current;
+                    current = current->left;
+                } else {
+                    current = current->right;
+                }
+            }
+
+            return result;
+        }
+    }
+
+    /**
+     * @param node in the tree.
+     * @return the node with the previous key in order, nullptr if node holds the smallest key.
+     */
+    Node* predecessor(Node *node) const {
+        if (node->left) {
+            return maximum(node->left);
+        }
+
+        if constexpr (NodePolicy::parent_links) {
+            Node *parent{node->parent};
+
+            while (parent and node == parent->left) {
+                node = parent;
+                parent = parent->parent;
+            }
+
+            return parent;
+        } else {
+            // last ancestor the path to node turns right at
+            Node *result{nullptr};
+            Node *current{root};
+
+            while (current != node) {
+                if (comparator(node->key, current->key)) {
+                    current = current->left;
+                } else {
+                    result = current;
+                    current = current->right;
+                }
+            }
+
+            return result;
+        }
+    }
+
+    /**
+     * @param node whose height, subtree size & summary are recomputed from its children.
+     */
+    static void updateNode(Node *node) {
+        node->height = static_cast<typename NodePolicy::height_type>(
+            1 + std::max(height(node->left), height(node->right))
+        );
+        updateFields(node);
+    }
+
+    /**
+     * @param node whose subtree size & summary are recomputed from its children,
+     *             if the node policy has them.
+     */
+    static void updateFields(Node *node) {
+        if constexpr (counted) {
+            node->size = static_cast<typename NodePolicy::subtree_size_type>(
+                1 + subtreeSize(node->left) + subtreeSize(node->right)
+            );
+        }
+
+        if constexpr (augmented) {
+            using Augmentation = typename NodePolicy::augmentation;
+
+            node->summary = Augmentation::combine(
+                Augmentation::combine(subtreeSummary(node->left), Augmentation::lift(node->key)),
+                subtreeSummary(node->right)
+            );
+        }
+    }
+
+    /**
+     * Resets a detached node to a single leaf.
+     *
+     * @param node whose children are dropped, its parent link is left to the caller.
+     */
+    static void resetLeaf(Node *node) {
+        setLeft(node, nullptr);
+        setRight(node, nullptr);
+        node->height = 1;
+        updateFields(node);
+    }
+
+    /**
+     * @param root of a subtree to perform a right rotation on.
+     * @return the new root for the subtree.
+     */
+    static Node* rightRotation(Node *root) {
+        Node *new_root = root->left;
+        setLeft(root, new_root->right);
+        setRight(new_root, root);
+
+        // update height for roots
+        updateNode(root);
+        updateNode(new_root);
+
+        return new_root;
+    }
+
+    /**
+     * @param root of a subtree to perform a left rotation on.
+     * @return the new root for the subtree.
+     */
+    static Node* leftRotation(Node *root) {
+        Node *new_head = root->right;
+        setRight(root, new_head->left);
+        setLeft(new_head, root);
+
+        // update height for roots
+        updateNode(root);
+        updateNode(new_head);
+
+        return new_head;
+    }
+
+    /**
+     * Updates the height of the root & performs the rotations needed to balance it.
+     *
+     * @param root of a subtree whose children are balanced, and differ in height by at most 2.
+     * @return the new root of the subtree.
+     */
+    static Node* rebalance(Node *root) {
+        const auto balance{height(root->left) - height(root->right)};
+
+        if (1 < balance) {
+            if (height(root->left->left) < height(root->left->right)) {
+                setLeft(root, leftRotation(root->left));
+            }
+
+            return rightRotation(root);
+        } else if (balance < -1) {
+            if (height(root->right->right) < height(root->right->left)) {
+                setRight(root, rightRotation(root->right));
+            }
+
+            return leftRotation(root);
+        }
+
+        // skip the write if the height did not change, to keep the cache line clean
+        const auto new_height{1 + std::max(height(root->left), height(root->right))};
+
+        if (root->height != new_height) {
+            root->height = static_cast<typename NodePolicy::height_type>(new_height);
+        }
+
+        updateFields(root);
+
+        return root;
+    }
+
+    /**
+     * @param node new root of the tree, its parent link is cleared.
+     */
+    void setRoot(Node *node) {
+        root = node;
+        setParent(node, nullptr);
+    }
+
+    /**
+     * Replaces a child of parent, or the root if parent is nullptr.
+     *
+     * @param parent of the replaced child.
+     * @param old_child child to be replaced.
+     * @param new_child node taking its place.
+     */
+    void relink(Node *parent, Node *old_child, Node *new_child) {
+        if (not parent) {
+            setRoot(new_child);
+        } else if (parent->left == old_child) {
+            setLeft(parent, new_child);
+        } else {
+            setRight(parent, new_child);
+        }
+    }
+
+    /**
+     * Records the rotation rebalance() is about to perform on the node, if any.
+     *
+     * @param node root of a subtree whose children are balanced.
+     */
+    void recordRotations(const Node *node) const {
+        const auto balance{height(node->left) - height(node->right)};
+
+        if (1 < balance) {
+            node_allocator.statistics()->record_rotation(height(node->left->left) < height(node->left->right));
+        } else if (balance < -1) {
+            node_allocator.statistics()->record_rotation(height(node->right->right) < height(node->right->left));
+        }
+    }
+
+    /**
+     * Rebalances the ancestors of a modified subtree, bottom-up.
+     * Stops at the first ancestor whose height did not change, since no height above it changed either.
+     * Subtree sizes & summaries, if any, are still updated up to the root.
+     *
+     * @param path ancestors of the modified subtree, starting at the root.
+     * @param depth number of ancestors in the path.
+     */
+    void rebalancePath(Node **path, size_type depth) {
+        while (depth--) {
+            Node *node{path[depth]};
+            const auto old_height{height(node)};
+
+            if constexpr (instrumented) {
+                recordRotations(node);
+            }
+
+            Node *subtree{rebalance(node)};
+
+            if (subtree != node) {
+                relink(depth ? path[depth - 1] : nullptr, node, subtree);
+            }
+
+            if (height(subtree) == old_height) {
+                if constexpr (counted or augmented) {
+                    while (depth--) {
+                        updateFields(path[depth]);
+                    }
+                }
+
+                return;
+            }
+        }
+    }
+
+    /**
+     * @param value to be inserted in the tree, or a key equivalent to it.
+     * @param makeNode returns the node to be linked, only called if the value is not present.
+     * @return pointer to the node holding the value, & true if it was newly inserted.
+     */
+    template <typename K, typename MakeNode>
+    std::pair<Node*, bool> insertNode(const K& value, MakeNode&& makeNode) {
+        Node *path[max_height];
+        size_type depth{0};
+        Node *current{root};
+        bool to_left{false};
+
+        // last node the descent turned right at, the only one that can equal the value
+        Node *candidate{nullptr};
+
+        while (current) {
+            if constexpr (threeWay<T>()) {
+                const auto order{comparator.compare(value, current->key)};
+
+                if (order == 0) {
+                    // Duplicates are not inserted
+                    return {current, false};
+                }
+
+                to_left = order < 0;
+            } else {
+                to_left = comparator(value, current->key);
+
+                if (not to_left) {
+                    candidate = current;
+                }
+            }
+
+            path[depth++] = current;
+            current = to_left ? current->left : current->right;
+        }
+
+        if (candidate and not comparator(candidate->key, value)) {
+            // Duplicates are not inserted
+            return {candidate, false};
+        }
+
+        Node *node{makeNode()};
+
+        if (not depth) {
+            root = node;
+        } else if (to_left) {
+            setLeft(path[depth - 1], node);
+        } else {
+            setRight(path[depth - 1], node);
+        }
+
+        rebalancePath(path, depth);
+        checkInvariants();
+
+        return {node, true};
+    }
+
+    /**
+     * Rebalances the ancestors of a modified subtree bottom-up through the parent links,
+     * like rebalancePath() without recording the path on the way down.
+     *
+     * @param node lowest ancestor of the modified subtree, nullptr for none.
+     */
+    void rebalanceUp(Node *node) {
+        while (node) {
+            Node *parent{node->parent};
+            const auto old_height{height(node)};
+
+            if constexpr (instrumented) {
+                recordRotations(node);
+            }
+
+            Node *subtree{rebalance(node)};
+
+            if (subtree != node) {
+                relink(parent, node, subtree);
+            }
+
+            if (height(subtree) == old_height) {
+                if constexpr (counted or augmented) {
+                    for (; parent; parent = parent->parent) {
+                        updateFields(parent);
+                    }
+                }
+
+                return;
+            }
+
+            node = parent;
+        }
+    }
+
+    /**
+     * Climbs from the finger to the lowest ancestor whose subtree spans the value,
+     * that is the lowest subtree a descent for the value can start from.
+     * A subtree is spanned once the climb passes an ancestor on the far side of the value,
+     * since every ancestor passed on the near side lies between the finger & the value.
+     *
+     * @param finger node to climb from, nullptr for the node with the largest key.
+     * @param value T or a key equivalent to it.
+     * @return node to descend from, the root without parent links.
+     */
+    template <typename K>
+    Node* fingerStart(Node *finger, const K& value) const {
+        if constexpr (not NodePolicy::parent_links) {
+            return root;
+        } else {
+            Node *child{finger ? finger : maximum(root)};
+
+            if (not child) {
+                return nullptr;
+            }
+
+            const bool after{comparator(child->key, value)};
+
+            if (not after and not comparator(value, child->key)) {
+                return child;
+            }
+
+            Node *start{child};
+
+            for (Node *parent{child->parent}; parent; child = parent, parent = parent->parent) {
+                // ancestors on the side of the value that the climb comes from lie between the finger & the value
+                if (after ? child != parent->left : child != parent->right) {
+                    continue;
+                }
+
+                if (after ? comparator(value, parent->key) : comparator(parent->key, value)) {
+                    return start;
+                }
+
+                if (after ? not comparator(parent->key, value) : not comparator(value, parent->key)) {
+                    return parent;
+                }
+
+                start = parent;
+            }
+
+            return start;
+        }
+    }
+
+    /**
+     * Inserts by descending from fingerStart() & rebalancing through the parent links.
+     * Falls back to insertNode() without parent links.
+     *
+     * @param finger node to start from, nullptr for the node with the largest key.
+     * @param value to be inserted in the tree, or a key equivalent to it.
+     * @param makeNode returns the node to be linked, only called if the value is not present.
+     * @return pointer to the node holding the value, & true if it was newly inserted.
+     */
+    template <typename K, typename MakeNode>
+    std::pair<Node*, bool> insertNear(Node *finger, const K& value, MakeNode&& makeNode) {
+        if constexpr (not NodePolicy::parent_links) {
+            return insertNode(value, std::forward<MakeNode>(makeNode));
+        } else {
+            Node *current{fingerStart(finger, value)};
+            Node *parent{nullptr};
+            bool to_left{false};
+
+            // last node the descent turned right at, the only one that can equal the value
+            Node *candidate{nullptr};
+
+            while (current) {
+                if constexpr (threeWay<T>()) {
+                    const auto order{comparator.compare(value, current->key)};
+
+                    if (order == 0) {
+                        // Duplicates are not inserted
+                        return {current, false};
+                    }
+
+                    to_left = order < 0;
+                } else {
+                    to_left = comparator(value, current->key);
+
+                    if (not to_left) {
+                        candidate = current;
+                    }
+                }
+
+                parent = current;
+                current = to_left ? current->left : current->right;
+            }
+
+            if (candidate and not comparator(candidate->key, value)) {
+                // Duplicates are not inserted
+                return {candidate, false};
+            }
+
+            Node *node{makeNode()};
+
+            if (not parent) {
+                setRoot(node);
+            } else if (to_left) {
+                setLeft(parent, node);
+            } else {
+                setRight(parent, node);
+            }
+
+            rebalanceUp(parent);
+            checkInvariants();
+
+            return {node, true};
+        }
+    }
+
+    /**
+     * @param value to be removed from the tree, T or a key equivalent to it.
+     * @return true if the value was present & removed.
+     */
+    template <typename K>
+    bool removeNode(const K& value) {
+        return removeNode(value, [](const T&) { return true; });
+    }
+
+    /**
+     * @param value to be removed from the tree, T or a key equivalent to it.
+     * @param unlink called with the stored value once found, returns false to keep it in the tree.
+     *               It may modify the value, but not its ordering.
+     * @return true if the value was present & removed.
+     */
+    template <typename K, typename Unlink>
+    bool removeNode(const K& value, Unlink&& unlink) {
+        Node *node{unlinkNode(value, std::forward<Unlink>(unlink))};
+
+        if (not node) {
+            return false;
+        }
+
+        // Deallocate old value
+        destroyNode(node);
+
+        return true;
+    }
+
+    /**
+     * @param value key of the node to be extracted, T or a key equivalent to it.
+     * @return handle owning the unlinked node, empty if the value is not present.
+     */
+    template <typename K>
+    node_type extractHandle(const K& value) {
+        Node *node{unlinkNode(value)};
+        return node ? node_type(node, node_allocator) : node_type();
+    }
+
+    /**
+     * Unlinks the node holding the value & rebalances the tree.
+     * The unlinked node is reset to a single leaf, ready to be linked again.
+     *
+     * @param value T or a key equivalent to it.
+     * @return the unlinked node, nullptr if the value is not present.
+     */
+    template <typename K>
+    Node* unlinkNode(const K& value) {
+        return unlinkNode(value, [](const T&) { return true; });
+    }
+
+    /**
+     * @param value T or a key equivalent to it.
+     * @param unlink called with the stored value once found, returns false to keep it in the tree.
+     *               It may modify the value, but not its ordering.
+     * @return the unlinked node, nullptr if the value is not present or was kept.
+     */
+    template <typename K, typename Unlink>
+    Node* unlinkNode(const K& value, Unlink&& unlink) {
+        Node *path[max_height];
+        size_type depth{0};
+        Node *current{root};
+
+        if constexpr (threeWay<K>()) {
+            while (current) {
+                const auto order{comparator.compare(value, current->key)};
+
+                if (order == 0) {
+                    break;
+                }
+
+                path[depth++] = current;
+                current = order < 0 ? current->left : current->right;
+            }
+        } else {
+            // descend to the bottom, then cut the path back to the last candidate
+            Node *candidate{nullptr};
+            size_type candidate_depth{0};
+
+            while (current) {
+                if (comparator(value, current->key)) {
+                    path[depth++] = current;
+                    current = current->left;
+                } else {
+                    candidate = current;
+                    candidate_depth = depth;
+                    path[depth++] = current;
+                    current = current->right;
+                }
+            }
+
+            if (candidate and not comparator(candidate->key, value)) {
+                current = candidate;
+                depth = candidate_depth;
+            }
+        }
+
+        // Value not present, or kept
+        if (not current or not unlink(current->key)) {
+            return nullptr;
+        }
+
+        Node *parent{depth ? path[depth - 1] : nullptr};
+
+        if (not current->left) { // Does not have left child
+            relink(parent, current, current->right);
+        } else if (not current->right) { // Does not have right child
+            relink(parent, current, current->left);
+        } else { // Has both children
+            /*
+             * The in-order neighbour on the taller side is unlinked & takes the place of the removed node,
+             * shortening the taller side keeps the rotations on the way up to a minimum.
+             */
+            const auto index{depth};
+            path[depth++] = current;
+
+            const bool from_left{height(current->right) < height(current->left)};
+            Node *replacement{from_left ? current->left : current->right};
+
+            if (from_left) {
+                while (replacement->right) {
+                    path[depth++] = replacement;
+                    replacement = replacement->right;
+                }
+
+                relink(path[depth - 1], replacement, replacement->left);
+            } else {
+                while (replacement->left) {
+                    path[depth++] = replacement;
+                    replacement = replacement->left;
+                }
+
+                relink(path[depth - 1], replacement, replacement->right);
+            }
+
+            setLeft(replacement, current->left);
+            setRight(replacement, current->right);
+            replacement->height = current->height;
+
+            relink(parent, current, replacement);
+            path[index] = replacement;
+        }
+
+        rebalancePath(path, depth);
+        checkInvariants();
+
+        resetLeaf(current);
+        setParent(current, nullptr);
+
+        return current;
+    }
+
+    /**
+     * Unlinks a node of the tree through the parent links & rebalances its ancestors bottom-up,
+     * like unlinkNode() without the descent. Only available with parent links.
+     * The unlinked node is reset to a single leaf, ready to be linked again.
+     *
+     * @param current node of the tree.
+     * @return the unlinked node.
+     */
+    Node* unlinkAt(Node *current) {
+        static_assert(NodePolicy::parent_links, "unlinkAt() needs a node policy with parent links");
+
+        Node *parent{current->parent};
+
+        // lowest node whose subtree lost a node
+        Node *lowest{parent};
+
+        if (not current->left) { // Does not have left child
+            relink(parent, current, current->right);
+        } else if (not current->right) { // Does not have right child
+            relink(parent, current, current->left);
+        } else { // Has both children
+            // the in-order neighbour on the taller side takes the place of the removed node, see unlinkNode()
+            const bool from_left{height(current->right) < height(current->left)};
+            Node *replacement{from_left ? current->left : current->right};
+
+            while (from_left ? replacement->right : replacement->left) {
+                replacement = from_left ? replacement->right : replacement->left;
+            }
+
+            Node *replacement_parent{replacement->parent};
+            relink(replacement_parent, replacement, from_left ? replacement->left : replacement->right);
+
+            setLeft(replacement, current->left);
+            setRight(replacement, current->right);
+            replacement->height = current->height;
+
+            relink(parent, current, replacement);
+            lowest = replacement_parent == current ? replacement : replacement_parent;
+        }
+
+        rebalanceUp(lowest);
+        checkInvariants();
+
+        resetLeaf(current);
+        setParent(current, nullptr);
+
+        return current;
+    }
+
+    /**
+     * @param key T or a key the comparator accepts.
+     * @param node_key key stored in a node.
+     * @return negative if key comes before node_key, positive if after, 0 if equivalent.
+     */
+    template <typename K>
+    int compareKeys(const K& key, const T& node_key) const {
+        if constexpr (threeWay<K>()) {
+            return comparator.compare(key, node_key);
+        } else {
+            return comparator(key, node_key) ? -1 : comparator(node_key, key) ? 1 : 0;
+        }
+    }
+
+    /**
+     * Joins two subtrees & a pivot in O(|height(left) - height(right)|).
+     * Descends the spine of the taller subtree down to the height of the other one,
+     * links them under the pivot there, then rebalances on the way back up.
+     *
+     * @param left subtree whose keys all come before the pivot.
+     * @param pivot detached node.
+     * @param right subtree whose keys all come after the pivot.
+     * @return root of the joined subtree, whose parent link is left to the caller.
+     */
+    static Node* join(Node *left, Node *pivot, Node *right) {
+        if (height(right) + 1 < height(left)) {
+            setRight(left, join(left->right, pivot, right));
+            return rebalance(left);
+        }
+
+        if (height(left) + 1 < height(right)) {
+            setLeft(right, join(left, pivot, right->left));
+            return rebalance(right);
+        }
+
+        setLeft(pivot, left);
+        setRight(pivot, right);
+        updateNode(pivot);
+
+        return pivot;
+    }
+
+    /**
+     * @param root of a non-empty subtree.
+     * @return the subtree without its largest node, & that node detached.
+     */
+    static std::pair<Node*, Node*> splitLast(Node *root) {
+        Node *left{root->left};
+        Node *right{root->right};
+
+        if (not right) {
+            resetLeaf(root);
+            return {left, root};
+        }
+
+        const auto [rest, last] = splitLast(right);
+        return {join(left, root, rest), last};
+    }
+
+    /**
+     * Joins two subtrees without a pivot, the largest node of left takes that role.
+     *
+     * @param left subtree whose keys all come before the ones of right.
+     * @param right subtree.
+     * @return root of the joined subtree.
+     */
+    static Node* join2(Node *left, Node *right) {
+        if (not left) {
+            return right;
+        }
+
+        const auto [rest, last] = splitLast(left);
+        return join(rest, last, right);
+    }
+
+    /**
+     * Result of splitting a subtree around a key.
+     */
+    struct split_result {
+        // Subtree of the keys coming before the split key.
+        Node *left;
+
+        // Detached node equivalent to the split key, nullptr if there is none.
+        Node *found;
+
+        // Subtree of the keys coming after the split key.
+        Node *right;
+    };
+
+    /**
+     * Splits a subtree around a key in O(log n), by joining back the pieces cut off the search path.
+     *
+     * @param root of the subtree.
+     * @param key T or a key the comparator accepts.
+     * @return the keys before & after the key, & the detached node equivalent to it.
+     */
+    template <typename K>
+    split_result split(Node *root, const K& key) const {
+        if (not root) {
+            return {nullptr, nullptr, nullptr};
+        }
+
+        Node *left{root->left};
+        Node *right{root->right};
+        const auto order{compareKeys(key, root->key)};
+
+        if (order < 0) {
+            const auto pieces{split(left, key)};
+            return {pieces.left, pieces.found, join(pieces.right, root, right)};
+        }
+
+        if (0 < order) {
+            const auto pieces{split(right, key)};
+            return {join(left, root, pieces.left), pieces.found, pieces.right};
+        }
+
+        resetLeaf(root);
+
+        return {left, root, right};
+    }
+
+    /**
+     * Merges sorted detached nodes into a subtree, splitting it around the middle node.
+     * Nodes whose key is already present are destroyed.
+     *
+     * @param root of the subtree.
+     * @param first start of the nodes, strictly increasing.
+     * @param last end of the nodes.
+     * @param inserted incremented for every linked node.
+     * @return root of the merged subtree.
+     */
+    Node* insertSorted(Node *root, Node **first, Node **last, size_type& inserted) {
+        if (first == last) {
+            return root;
+        }
+
+        if (not root) {
+            auto linkNode = [](Node *node) {
+                return node;
+            };
+
+            inserted += last - first;
+            return buildSorted(first, last - first, linkNode);
+        }
+
+        Node **middle{first + (last - first) / 2};
+        const auto pieces{split(root, (*middle)->key)};
+        Node *pivot{*middle};
+
+        if (pieces.found) {
+            // keep the node already in the tree
+            destroyNode(pivot);
+            pivot = pieces.found;
+        } else {
+            ++inserted;
+        }
+
+        Node *left{insertSorted(pieces.left, first, middle, inserted)};
+        Node *right{insertSorted(pieces.right, middle + 1, last, inserted)};
+
+        return join(left, pivot, right);
+    }
+
+    /**
+     * Removes sorted keys from a subtree, splitting it around the middle key.
+     *
+     * @param root of the subtree.
+     * @param first start of the keys, sorted.
+     * @param last end of the keys.
+     * @param erased incremented for every removed node.
+     * @return root of the remaining subtree.
+     */
+    template <typename RandomIt>
+    Node* eraseSorted(Node *root, RandomIt first, RandomIt last, size_type& erased) {
+        if (not root or first == last) {
+            return root;
+        }
+
+        const auto middle{first + (last - first) / 2};
+        const auto pieces{split(root, *middle)};
+
+        if (pieces.found) {
+            destroyNode(pieces.found);
+            ++erased;
+        }
+
+        Node *left{eraseSorted(pieces.left, first, middle, erased)};
+        Node *right{eraseSorted(pieces.right, middle + 1, last, erased)};
+
+        return join2(left, right);
+    }
+
+    /**
+     * @param key splitting the tree, T or a key the comparator accepts.
+     * @return tree holding the keys not before key, removed from this tree.
+     */
+    template <typename K>
+    AVL splitTree(const K& key) {
+        const auto pieces{split(root, key)};
+
+        AVL result(comparator, get_allocator());
+        result.setRoot(pieces.found ? join(nullptr, pieces.found, pieces.right) : pieces.right);
+        setRoot(pieces.left);
+
+        checkInvariants();
+        result.checkInvariants();
+
+        return result;
+    }
+
+    /*
+     * Subtrees shorter than this are processed sequentially by the parallel operations,
+     * about 4K nodes, so that each job outweighs its scheduling cost.
+     */
+    static constexpr size_type parallel_cutoff_height{12};
+
+    /**
+     * Runs the set operations on the calling thread, dropped subtrees are destroyed at once.
+     */
+    struct SequentialExecutor {
+        AVL& tree;
+
+        void discard(Node *node) {
+            tree.destroySubtree(node);
+        }
+
+        template <typename Left, typename Right>
+        void fork(size_type, Left&& left, Right&& right) {
+            left();
+            right();
+        }
+    };
+
+    /**
+     * Runs the set operations on a pool. Dropped subtrees are collected per worker,
+     * & destroyed by the executor, so the allocator is never called concurrently.
+     */
+    struct ParallelExecutor {
+        ParallelExecutor(AVL& tree, WorkStealingPool& pool): tree{tree}, pool{pool}, garbage(pool.size()) {}
+
+        ParallelExecutor(const ParallelExecutor&) = delete;
+
+        ~ParallelExecutor() {
+            for (const auto& nodes: garbage) {
+                for (Node *node: nodes) {
+                    tree.destroySubtree(node);
+                }
+            }
+        }
+
+        void discard(Node *node) {
+            if (node) {
+                garbage[pool.current_worker()].push_back(node);
+            }
+        }
+
+        /**
+         * @param height of the larger input, small inputs are not worth a job.
+         */
+        template <typename Left, typename Right>
+        void fork(size_type height, Left&& left, Right&& right) {
+            if (parallel_cutoff_height < height) {
+                pool.fork_join(left, right);
+            } else {
+                left();
+                right();
+            }
+        }
+
+        AVL& tree;
+        WorkStealingPool& pool;
+
+        // Subtrees dropped by each worker.
+        std::vector<std::vector<Node*>> garbage;
+    };
+
+    /**
+     * Splits the second subtree around the root of the first, & recurses on both sides.
+     *
+     * @param first subtree, whose nodes are kept.
+     * @param second subtree, whose duplicates are discarded.
+     * @param executor running the recursion.
+     * @return root of the union.
+     */
+    template <typename Executor>
+    Node* unionOf(Node *first, Node *second, Executor& executor) {
+        if (not first) {
+            return second;
+        }
+
+        if (not second) {
+            return first;
+        }
+
+        Node *left{first->left};
+        Node *right{first->right};
+        const size_type depth{std::max(height(first), height(second))};
+        const auto pieces{split(second, first->key)};
+
+        executor.discard(pieces.found);
+
+        Node *merged_left;
+        Node *merged_right;
+
+        executor.fork(
+            depth,
+            [&] { merged_left = unionOf(left, pieces.left, executor); },
+            [&] { merged_right = unionOf(right, pieces.right, executor); }
+        );
+
+        return join(merged_left, first, merged_right);
+    }
+
+    /**
+     * @param first subtree, whose common nodes are kept.
+     * @param second subtree, discarded.
+     * @param executor running the recursion.
+     * @return root of the intersection.
+     */
+    template <typename Executor>
+    Node* intersectionOf(Node *first, Node *second, Executor& executor) {
+        if (not first or not second) {
+            executor.discard(first);
+            executor.discard(second);
+            return nullptr;
+        }
+
+        Node *left{first->left};
+        Node *right{first->right};
+        const size_type depth{std::max(height(first), height(second))};
+        const auto pieces{split(second, first->key)};
+
+        Node *common_left;
+        Node *common_right;
+
+        executor.fork(
+            depth,
+            [&] { common_left = intersectionOf(left, pieces.left, executor); },
+            [&] { common_right = intersectionOf(right, pieces.right, executor); }
+        );
+
+        if (pieces.found) {
+            executor.discard(pieces.found);
+            return join(common_left, first, common_right);
+        }
+
+        // first is detached, its old children were handed to the recursion
+        setLeft(first, nullptr);
+        setRight(first, nullptr);
+        executor.discard(first);
+
+        return join2(common_left, common_right);
+    }
+
+    /**
+     * @param first subtree, whose remaining nodes are kept.
+     * @param second subtree, discarded.
+     * @param executor running the recursion.
+     * @return root of the difference.
+     */
+    template <typename Executor>
+    Node* differenceOf(Node *first, Node *second, Executor& executor) {
+        if (not first or not second) {
+            executor.discard(second);
+            return first;
+        }
+
+        Node *left{second->left};
+        Node *right{second->right};
+        const size_type depth{std::max(height(first), height(second))};
+        const auto pieces{split(first, second->key)};
+
+        setLeft(second, nullptr);
+        setRight(second, nullptr);
+        executor.discard(second);
+        executor.discard(pieces.found);
+
+        Node *rest_left;
+        Node *rest_right;
+
+        executor.fork(
+            depth,
+            [&] { rest_left = differenceOf(pieces.left, left, executor); },
+            [&] { rest_right = differenceOf(pieces.right, right, executor); }
+        );
+
+        return join2(rest_left, rest_right);
+    }
+
+    /**
+     * Constructs & links the nodes of a range, forking on both halves of large ranges.
+     * Builds the same shape as buildSorted().
+     *
+     * @param first start of all the values.
+     * @param nodes storage of the nodes, one per value.
+     * @param constructed flags set once a node is constructed.
+     * @param begin start of the range.
+     * @param end end of the range.
+     * @param pool to run the construction on.
+     * @return root of the subtree.
+     */
+    template <typename RandomIt>
+    Node* buildRange(RandomIt first, Node **nodes, unsigned char *constructed,
+                     size_type begin, size_type end, WorkStealingPool& pool) {
+        if (begin == end) {
+            return nullptr;
+        }
+
+        const size_type middle{begin + (end - begin - 1) / 2};
+        Node *node{nodes[middle]};
+
+        NodeTraits::construct(node_allocator, node, std::in_place, first[middle]);
+        constructed[middle] = 1;
+
+        Node *left;
+        Node *right;
+        auto buildLeft = [&] { left = buildRange(first, nodes, constructed, begin, middle, pool); };
+        auto buildRight = [&] { right = buildRange(first, nodes, constructed, middle + 1, end, pool); };
+
+        if (size_type(1) << parallel_cutoff_height < end - begin) {
+            pool.fork_join(buildLeft, buildRight);
+        } else {
+            buildLeft();
+            buildRight();
+        }
+
+        setLeft(node, left);
+        setRight(node, right);
+        updateNode(node);
+
+        return node;
+    }
+
+    /**
+     * Parallel buildFromSorted() for an empty tree.
+     *
+     * @param first start of the values, strictly increasing.
+     * @param last end of the values.
+     * @param pool to run the construction on.
+     */
+    template <typename RandomIt>
+    void buildFromSorted(RandomIt first, RandomIt last, WorkStealingPool& pool) {
+        const auto count{static_cast<size_type>(last - first)};
+
+        if (not count) {
+            return;
+        }
+
+        // node construction is spread on the pool, allocation is not
+        std::vector<Node*> nodes(static_cast<std::size_t>(count));
+        std::vector<unsigned char> constructed(static_cast<std::size_t>(count), 0);
+        Node *block{nullptr};
+
+        if constexpr (is_slab_allocator<NodeAllocator>::value) {
+            block = NodeTraits::allocate(node_allocator, count);
+
+            for (size_type i{0}; i < count; i++) {
+                nodes[i] = block + i;
+            }
+        } else {
+            size_type allocated{0};
+
+            try {
+                for (; allocated < count; allocated++) {
+                    nodes[allocated] = NodeTraits::allocate(node_allocator, 1);
+                }
+            } catch (...) {
+                for (size_type i{0}; i < allocated; i++) {
+                    NodeTraits::deallocate(node_allocator, nodes[i], 1);
+                }
+
+                throw;
+            }
+        }
+
+        try {
+            pool.run([&] { setRoot(buildRange(first, nodes.data(), constructed.data(), 0, count, pool)); });
+        } catch (...) {
+            for (size_type i{0}; i < count; i++) {
+                if (constructed[i]) {
+                    NodeTraits::destroy(node_allocator, nodes[i]);
+                }
+
+                if (not block) {
+                    NodeTraits::deallocate(node_allocator, nodes[i], 1);
+                }
+            }
+
+            if (block) {
+                NodeTraits::deallocate(node_allocator, block, count);
+            }
+
+            throw;
+        }
+
+        checkInvariants();
+    }
+
+    /**
+     * Slot of a display row, in the complete binary tree layout of the rendered subtree.
+     */
+    struct DisplaySlot {
+        // Position in the row, from the left.
+        size_type index;
+
+        // Node drawn in the slot.
+        Node *node;
+
+        // True if the whole subtree of the node is drawn as a placeholder.
+        bool collapsed;
+    };
+
+    // Present slots of a display row, from left to right.
+    using DisplayRow = std::vector<DisplaySlot>;
+
+    /**
+     * Formats keys for the display, reusing its buffers across keys.
+     * Arithmetic keys go through to_chars, the others through one reused stream.
+     */
+    class KeyFormatter {
+    public:
+        /**
+         * @param key to be formatted.
+         * @return text of the key, valid until the next call.
+         */
+        std::string_view operator()(const T& key) {
+            constexpr bool character{std::is_same_v<T, bool> or std::is_same_v<T, char> or
+                                     std::is_same_v<T, signed char> or std::is_same_v<T, unsigned char>};
+
+            if constexpr (std::is_integral_v<T> and not character) {
+                return formatNumber(key);
+            }
+#if defined(__cpp_lib_to_chars)
+            else if constexpr (std::is_floating_point_v<T>) {
+                return formatNumber(key);
+            }
+#endif
+            else {
+                stream.str(std::string());
+                stream.clear();
+                stream << key;
+                text = stream.str();
+                return text;
+            }
+        }
+
+        /**
+         * @param count number of keys in a collapsed subtree.
+         * @return text of its placeholder, valid until the next call.
+         */
+        std::string_view placeholder(size_type count) {
+            text = '[' + std::to_string(count) + (count == 1 ? " key]" : " keys]");
+            return text;
+        }
+    private:
+        /**
+         * @param number arithmetic key.
+         * @return digits of the key.
+         */
+        template <typename N>
+        std::string_view formatNumber(const N& number) {
+            const auto [end, error] = std::to_chars(digits, digits + sizeof(digits), number);
+            return error == std::errc() ? std::string_view(digits, static_cast<std::size_t>(end - digits)) : std::string_view();
+        }
+
+        // Buffer of the arithmetic keys, large enough for any of them.
+        char digits[64]{};
+
+        // Stream & text of the other keys & placeholders.
+        std::ostringstream stream{};
+        std::string text{};
+    };
+
+    /**
+     * Without subtree sizes, the counting stops at limit.
+     *
+     * @param node root of a subtree, may be nullptr.
+     * @param limit count after which the nodes need not be counted.
+     * @return number of nodes in the subtree, or at least limit if it holds more.
+     */
+    static size_type boundedSize(Node *node, size_type limit) {
+        if constexpr (counted) {
+            return subtreeSize(node);
+        } else {
+            if (not node or limit <= 0) {
+                return 0;
+            }
+
+            const auto left{boundedSize(node->left, limit - 1)};
+            return 1 + left + boundedSize(node->right, limit - 1 - left);
+        }
+    }
+
+    /**
+     * @param node root of a subtree.
+     * @param depth of the node below the rendered root.
+     * @param options of the rendering.
+     * @return true if the subtree is drawn as a placeholder.
+     */
+    static bool collapses(Node *node, size_type depth, const AvlDisplayOptions& options) {
+        if (options.max_depth <= depth) {
+            return node->left or node->right;
+        }
+
+        // the rendered root is always expanded
+        return depth and options.collapse_above and
+               options.collapse_above < boundedSize(node, options.collapse_above + 1);
+    }
+
+    /**
+     * @param row of the display.
+     * @param depth of the row below the rendered root.
+     * @param options of the rendering.
+     * @return the row below it, empty after the last one.
+     */
+    static DisplayRow nextDisplayRow(const DisplayRow& row, size_type depth, const AvlDisplayOptions& options) {
+        DisplayRow next{};
+
+        for (const auto& slot: row) {
+            if (slot.collapsed) {
+                continue;
+            }
+
+            if (Node *left{slot.node->left}) {
+                next.push_back({2 * slot.index, left, collapses(left, depth + 1, options)});
+            }
+
+            if (Node *right{slot.node->right}) {
+                next.push_back({2 * slot.index + 1, right, collapses(right, depth + 1, options)});
+            }
+        }
+
+        return next;
+    }
+
+    /**
+     * @param out output stream.
+     * @param count number of spaces written to it.
+     */
+    static void writeSpaces(std::ostream& out, size_type count) {
+        static constexpr char spaces[]{"                                                                "};
+
+        for (; 0 < count; count -= static_cast<size_type>(sizeof(spaces) - 1)) {
+            out.write(spaces, static_cast<std::streamsize>(std::min(count, static_cast<size_type>(sizeof(spaces) - 1))));
+        }
+    }
+
+    /**
+     * @param node of the tree.
+     * @return height of its left subtree minus the height of its right subtree.
+     */
+    static size_type balanceFactor(Node *node) {
+        return height(node->left) - height(node->right);
+    }
+
+    /**
+     * Visits every node in preorder, numbering the nodes as they are discovered, the root being 0.
+     *
+     * @param visit called with each node, its number & the numbers of its children, -1 if absent.
+     */
+    template <typename Visit>
+    void visitNumbered(Visit&& visit) const {
+        // at most one pending right child per level
+        std::pair<Node*, size_type> pending[max_height];
+        size_type depth{0};
+        size_type next_id{1};
+
+        if (root) {
+            pending[depth++] = {root, 0};
+        }
+
+        while (depth) {
+            const auto [node, id] = pending[--depth];
+            const size_type left_id{node->left ? next_id++ : -1};
+            const size_type right_id{node->right ? next_id++ : -1};
+
+            visit(node, id, left_id, right_id);
+
+            if (node->right) {
+                pending[depth++] = {node->right, right_id};
+            }
+
+            if (node->left) {
+                pending[depth++] = {node->left, left_id};
+            }
+        }
+    }
+
+    /**
+     * Escapes quotes, backslashes & newlines, and the other control characters as JSON \u escapes.
+     *
+     * @param out output stream.
+     * @param text written to it, escaped.
+     */
+    static void writeEscaped(std::ostream& out, std::string_view text) {
+        static constexpr char hex[]{"0123456789abcdef"};
+
+        for (const char c: text) {
+            const auto code{static_cast<unsigned char>(c)};
+
+            if (c == '"' or c == '\\') {
+                out << '\\' << c;
+            } else if (c == '\n') {
+                out << "\\n";
+            } else if (code < 0x20) {
+                out << "\\u00" << hex[code >> 4] << hex[code & 0xF];
+            } else {
+                out << c;
+            }
+        }
+    }
+
+    /**
+     * @param out output stream.
+     * @param key written as a JSON number if it is one, as a string otherwise.
+     * @param format formatter of the keys.
+     */
+    static void writeJsonKey(std::ostream& out, const T& key, KeyFormatter& format) {
+        if constexpr (std::is_same_v<T, bool>) {
+            out << (key ? "true" : "false");
+            return;
+        } else if constexpr (std::is_arithmetic_v<T> and not std::is_same_v<T, char> and
+                             not std::is_same_v<T, signed char> and not std::is_same_v<T, unsigned char>) {
+            // infinities & NaN have no JSON number
+            if (not std::is_floating_point_v<T> or std::isfinite(static_cast<long double>(key))) {
+                out << format(key);
+                return;
+            }
+        }
+
+        out << '"';
+        writeEscaped(out, format(key));
+        out << '"';
+    }
+
+    /**
+     * Streams the subtree row by row, holding a single row of nodes at a time.
+     * A first pass measures the cells & the left margin, a second one writes the rows.
+     * Rows & slashes are laid out as if the subtree were complete, so each row is as wide
+     * as 2^depth cells, limiting the depth keeps it readable.
+     *
+     * @param out output stream to display the subtree to.
+     * @param top root of the rendered subtree.
+     * @param options of the rendering.
+     */
+    void displaySubtree(std::ostream& out, Node *top, const AvlDisplayOptions& options) const {
+        KeyFormatter format{};
+
+        auto text = [&](const DisplaySlot& slot) {
+            return slot.collapsed ? format.placeholder(subtreeSize(slot.node)) : format(slot.node->key);
+        };
+
+        // first pass: widest cell, number of rows & leftmost slot of each row
+        size_type cell_width{3};
+        std::vector<std::pair<size_type, size_type>> leftmost{};
+        DisplayRow row{{0, top, collapses(top, 0, options)}};
+
+        for (size_type depth{0}; not row.empty(); depth++) {
+            for (const auto& slot: row) {
+                cell_width = std::max(cell_width, static_cast<size_type>(text(slot).length()));
+            }
+
+            leftmost.emplace_back(row.front().index, static_cast<size_type>(text(row.front()).length()));
+            row = nextDisplayRow(row, depth, options);
+        }
+
+        // make sure the cell_width is an odd number
+        if (cell_width % 2 == 0) {
+            cell_width++;
+        }
+
+        const auto rows{static_cast<size_type>(leftmost.size())};
+        const size_type half_cell{(cell_width + 1) / 2};
+
+        /*
+         * Counting levels from the bottom row, level l has 2^l * half_cell - 1 rows of slashes above it,
+         * and its cells start after a left pad of (2^l - 1) * half_cell, then every 2^l * (cell_width + 1).
+         */
+        auto slashRows = [&](size_type depth) {
+            return (size_type(1) << (rows - 1 - depth)) * half_cell - 1;
+        };
+
+        auto leftPad = [&](size_type depth) {
+            return ((size_type(1) << (rows - 1 - depth)) - 1) * half_cell;
+        };
+
+        auto cellColumn = [&](size_type depth, size_type index, size_type length) {
+            // odd padding goes to the outer side of the children
+            const size_type padding{cell_width - length};
+            const size_type leading{index % 2 ? padding / 2 : padding - padding / 2};
+            return leftPad(depth) + index * (cell_width + 2 * leftPad(depth) + 1) + leading;
+        };
+
+        auto slashColumn = [&](size_type depth, size_type index, size_type line) {
+            const size_type space{slashRows(depth)};
+            const size_type left_space{space + 1 + line};
+            const size_type right_space{space - 1 - line};
+            const size_type pair_offset{index / 2 * (4 * space + 4)};
+            return left_space + pair_offset + (index % 2 ? 2 * right_space + 2 : 0);
+        };
+
+        // the rows are shifted left so that the leftmost character starts the display
+        size_type margin{cellColumn(0, leftmost[0].first, leftmost[0].second)};
+
+        for (size_type depth{1}; depth < rows; depth++) {
+            const auto [index, length] = leftmost[depth];
+            margin = std::min(margin, cellColumn(depth, index, length));
+            margin = std::min(margin, slashColumn(depth, index, index % 2 ? slashRows(depth) - 1 : 0));
+        }
+
+        // second pass: stream every row
+        row = {{0, top, collapses(top, 0, options)}};
+
+        for (size_type depth{0}; depth < rows; depth++) {
+            if (depth) {
+                // slash rows are written top-down, the last one touches the row below
+                for (size_type line{slashRows(depth)}; line-- > 0;) {
+                    size_type column{margin};
+                    out << ' ';
+
+                    for (const auto& slot: row) {
+                        const size_type target{slashColumn(depth, slot.index, line)};
+                        writeSpaces(out, target - column);
+                        out << (slot.index % 2 ? '\\' : '/');
+                        column = target + 1;
+                    }
+
+                    out << '\n';
+                }
+            }
+
+            size_type column{margin};
+            out << ' ';
+
+            for (const auto& slot: row) {
+                const auto value{text(slot)};
+                const size_type target{cellColumn(depth, slot.index, static_cast<size_type>(value.length()))};
+                writeSpaces(out, target - column);
+                out << value;
+                column = target + static_cast<size_type>(value.length());
+            }
+
+            out << '\n';
+            row = nextDisplayRow(row, depth, options);
+        }
+    }
+public:
+    /**
+     * Draws the tree, one row of keys per level, linked by slashes.
+     *
+     * @param out output stream to display the AVL tree to
+     * @param options depth & collapsing limits of the rendering.
+     * @return reference to the given output stream
+     */
+    std::ostream& display(std::ostream& out, const AvlDisplayOptions& options) const {
+        // If this tree is empty, tell someone
+        if (not root) {
+            return out << "<empty tree>" << std::endl;
+        }
+
+        displaySubtree(out, root, options);
+        return out;
+    }
+
+    /**
+     * @param out output stream to display the AVL tree to
+     * @return reference to the given output stream
+     */
+    std::ostream& display(std::ostream& out) const {
+        return display(out, AvlDisplayOptions());
+    }
+
+    /**
+     * Writes the tree as a Graphviz digraph, each node labelled with its key, height & balance factor.
+     * The graph is streamed in O(n) time & O(log n) space.
+     *
+     * @param out output stream receiving the graph.
+     * @return reference to the given output stream.
+     */
+    std::ostream& write_dot(std::ostream& out) const {
+        KeyFormatter format{};
+        out << "digraph AVL {\n    node [shape=box];\n";
+
+        visitNumbered([&](Node *node, size_type id, size_type left_id, size_type right_id) {
+            out << "    n" << id << " [label=\"";
+            writeEscaped(out, format(node->key));
+            out << "\\nh=" << height(node) << " bf=" << balanceFactor(node) << "\"];\n";
+
+            if (node->left) {
+                out << "    n" << id << " -> n" << left_id << " [label=\"L\"];\n";
+            }
+
+            if (node->right) {
+                out << "    n" << id << " -> n" << right_id << " [label=\"R\"];\n";
+            }
+        });
+
+        return out << "}\n";
+    }
+
+    /**
+     * Writes the tree as a JSON adjacency list: {"root", "nodes": [{"id", "key", "height",
+     * "balance", "left", "right"}], "size"}, missing children & the root of an empty tree being null. Numeric keys are JSON numbers,
+     * the other keys are strings. The list is streamed in O(n) time & O(log n) space.
+     *
+     * @param out output stream receiving the document.
+     * @return reference to the given output stream.
+     */
+    std::ostream& write_json(std::ostream& out) const {
+        KeyFormatter format{};
+        size_type count{0};
+
+        auto writeId = [&](size_type id) -> std::ostream& {
+            return id < 0 ? out << "null" : out << id;
+        };
+
+        out << "{\"root\": " << (root ? "0" : "null") << ", \"nodes\": [";
+
+        visitNumbered([&](Node *node, size_type id, size_type left_id, size_type right_id) {
+            out << (count++ ? ",\n    " : "\n    ") << "{\"id\": " << id << ", \"key\": ";
+            writeJsonKey(out, node->key, format);
+            out << ", \"height\": " << height(node) << ", \"balance\": " << balanceFactor(node) << ", \"left\": ";
+            writeId(left_id) << ", \"right\": ";
+            writeId(right_id) << '}';
+        });
+
+        return out << (count ? "\n" : "") << "], \"size\": " << count << "}\n";
+    }
+
+    /**
+     * Draws the subtree rooted at the node holding the key.
+     *
+     * @param out output stream to display the subtree to.
+     * @param subtree_root key of the root of the drawn subtree.
+     * @param options depth & collapsing limits of the rendering.
+     * @return reference to the given output stream.
+     */
+    std::ostream& display(std::ostream& out, const T& subtree_root, const AvlDisplayOptions& options) const {
+        Node *top{search(root, subtree_root)};
+
+        if (not top) {
+            return out << "<key not found>" << std::endl;
+        }
+
+        displaySubtree(out, top, options);
+        return out;
+    }
+private:
+    /**
+     * @param out output stream to display the tree to.
+     * @param tree to be displayed.
+     * @return reference to the given output stream.
+     */
+    template<typename C, typename Cmp, typename A, typename P>
+    friend std::ostream& operator<<(std::ostream& out, const AVL<C, Cmp, A, P>& tree);
+
+    /*
+     * The map inserts through insertNode(), to build its values only when their key is absent.
+     */
+    template <typename K, typename V, typename Cmp, typename A, typename P>
+    friend class AVLMap;
+};
+
+/**
+ * @tparam T type stored in the AVL tree. Implicitly inferred.
+ * @tparam Compare ordering of the AVL tree. Implicitly inferred.
+ * @tparam Allocator allocator of the AVL tree. Implicitly inferred.
+ * @tparam NodePolicy node layout of the AVL tree. Implicitly inferred.
+ * @param out output stream to display the tree to.
+ * @param tree to be displayed.
+ * @return reference to the given output stream.
+ */
+template<typename T, typename Compare, typename Allocator, typename NodePolicy>
+std::ostream& operator<<(std::ostream &out, const AVL<T, Compare, Allocator, NodePolicy>& tree) {
+    return tree.display(out);
+}
+
+#endif // AVL_TREE_CPP
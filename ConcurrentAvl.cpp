@@ -0,0 +1,491 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "EpochDomain.cpp"
+#include "PathCopyingAvl.cpp"
+
+
+/**
+ * AVL tree safe for concurrent use, whose reads never lock.
+ *
+ * Published nodes are immutable. A writer copies the path it modifies, then publishes the new root
+ * atomically, so a reader descends a consistent version from the root it loaded.
+ * Replaced nodes are freed by the writers once no pinned reader can reach them.
+ * Writers are serialized by a mutex, only they call the allocator.
+ *
+ * @tparam T type of the data stored in the tree, copy constructible.
+ * @tparam Compare strict weak ordering of the keys, called concurrently by readers.
+ * @tparam Allocator std::allocator-compatible allocator, rebound to allocate the nodes.
+ */
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>>
+class ConcurrentAVL: private PathCopyingAVL<ConcurrentAVL<T, Compare, Allocator>> {
+public:
+    /* Custom size type for the AVL tree */
+    typedef long long size_type;
+
+    /**
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes of the tree.
+     * @param reader_slots maximum number of concurrent readers, see EpochDomain.
+     */
+    explicit ConcurrentAVL(const Compare& comp = Compare(), const Allocator& alloc = Allocator(),
+                           std::size_t reader_slots = 128):
+        comparator{comp}, node_allocator{alloc}, epochs{reader_slots} {}
+
+    ConcurrentAVL(const ConcurrentAVL&) = delete;
+
+    ConcurrentAVL& operator=(const ConcurrentAVL&) = delete;
+
+    /**
+     * No reader or writer may be running.
+     */
+    ~ConcurrentAVL() {
+        destroySubtree(root.load());
+
+        for (auto& batch: retired) {
+            for (Node *node: batch.nodes) {
+                destroyNode(node);
+            }
+        }
+    }
+
+    /**
+     * @param value to be searched for, without locking.
+     * @return true if the value is present.
+     */
+    [[nodiscard]] bool contains(const T& value) const {
+        const auto guard{epochs.pin()};
+        return search(value);
+    }
+
+    /**
+     * @param value to be searched for, without locking.
+     * @return copy of the key equivalent to value, empty if absent.
+     */
+    [[nodiscard]] std::optional<T> find(const T& value) const {
+        const auto guard{epochs.pin()};
+        return copyOf(search(value));
+    }
+
+    /**
+     * @param value bound of the search, without locking.
+     * @return copy of the first key not before value, empty if there is none.
+     */
+    [[nodiscard]] std::optional<T> lower_bound(const T& value) const {
+        const auto guard{epochs.pin()};
+        return copyOf(boundNode(value, false));
+    }
+
+    /**
+     * @param value bound of the search, without locking.
+     * @return copy of the first key after value, empty if there is none.
+     */
+    [[nodiscard]] std::optional<T> upper_bound(const T& value) const {
+        const auto guard{epochs.pin()};
+        return copyOf(boundNode(value, true));
+    }
+
+    /**
+     * Visits one consistent version of the tree, without locking.
+     * Writers keep going meanwhile, but the nodes they replace are kept until the visit ends.
+     *
+     * @param visit called with every key of the version, in order.
+     */
+    template <typename Visit>
+    void for_each(Visit&& visit) const {
+        const auto guard{epochs.pin()};
+        visitSubtree(root.load(), visit);
+    }
+
+    /**
+     * @return number of keys, possibly stale by the time it returns.
+     */
+    [[nodiscard]] size_type size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return true if the tree held no key when called.
+     */
+    [[nodiscard]] bool empty() const {
+        return not root.load();
+    }
+
+    /**
+     * @param value to be inserted, copied only if it is not present.
+     * @return true if the value was inserted.
+     */
+    bool insert(const T& value) {
+        std::lock_guard<std::mutex> lock{writer};
+        Node *current{root.load(std::memory_order_relaxed)};
+
+        if (searchFrom(current, value)) {
+            return false;
+        }
+
+        publish(current, [&] { return this->insertInto(current, value); });
+        count.fetch_add(1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    /**
+     * @param value to be deleted, if present.
+     * @return true if the value was removed.
+     */
+    bool remove(const T& value) {
+        std::lock_guard<std::mutex> lock{writer};
+        Node *current{root.load(std::memory_order_relaxed)};
+
+        if (not searchFrom(current, value)) {
+            return false;
+        }
+
+        publish(current, [&] { return this->removeFrom(current, value); });
+        count.fetch_sub(1, std::memory_order_relaxed);
+
+        return true;
+    }
+private:
+    friend class PathCopyingAVL<ConcurrentAVL>;
+
+    /**
+     * Immutable once reachable from the published root.
+     */
+    struct Node {
+        /**
+         * @param key copied into the node.
+         * @param left child of the node.
+         * @param right child of the node.
+         */
+        Node(const T& key, Node *left, Node *right):
+            key(key), height{static_cast<signed char>(1 + std::max(ConcurrentAVL::height(left), ConcurrentAVL::height(right)))},
+            left{left}, right{right} {}
+
+        T key;
+        signed char height;
+        Node *left;
+        Node *right;
+    };
+
+    // Allocator rebound to the node type, and its traits.
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+    // New versions of subtrees are plain nodes, owned by the write context until they are published.
+    using NodeHandle = Node*;
+
+    /**
+     * Nodes created & replaced by one write, only committed once the new root is published.
+     */
+    struct WriteContext {
+        std::vector<Node*> created;
+        std::vector<Node*> replaced;
+    };
+
+    /**
+     * Nodes unlinked by one write, tagged with its epoch.
+     */
+    struct RetiredBatch {
+        std::uint64_t epoch;
+        std::vector<Node*> nodes;
+    };
+
+    /**
+     * @param node reachable from a pinned version, may be nullptr.
+     * @return copy of its key, empty if nullptr.
+     */
+    static std::optional<T> copyOf(const Node *node) {
+        return node ? std::optional<T>(node->key) : std::nullopt;
+    }
+
+    /**
+     * @param value to be searched for in the published version.
+     * @return the node holding it, nullptr if absent.
+     */
+    const Node* search(const T& value) const {
+        return searchFrom(root.load(), value);
+    }
+
+    /**
+     * @param current root of the version to search.
+     * @param value to be searched for.
+     * @return the node holding it, nullptr if absent.
+     */
+    const Node* searchFrom(const Node *current, const T& value) const {
+        // one comparison per level, equality is only checked against the last candidate
+        const Node *candidate{nullptr};
+
+        while (current) {
+            if (comparator(current->key, value)) {
+                current = current->right;
+            } else {
+                candidate = current;
+                current = current->left;
+            }
+        }
+
+        return candidate and not comparator(value, candidate->key) ? candidate : nullptr;
+    }
+
+    /**
+     * @param value bound of the search in the published version.
+     * @param after true to skip the keys equivalent to value as well.
+     * @return the first node not before value, or after it, nullptr if there is none.
+     */
+    const Node* boundNode(const T& value, bool after) const {
+        const Node *result{nullptr};
+        const Node *current{root.load()};
+
+        while (current) {
+            if (after ? comparator(value, current->key) : not comparator(current->key, value)) {
+                result = current;
+                current = current->left;
+            } else {
+                current = current->right;
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * @param node root of a subtree of a pinned version.
+     * @param visit called with every key of the subtree, in order.
+     */
+    template <typename Visit>
+    static void visitSubtree(const Node *node, Visit& visit) {
+        if (node) {
+            visitSubtree(node->left, visit);
+            visit(node->key);
+            visitSubtree(node->right, visit);
+        }
+    }
+
+    /**
+     * @param node may be nullptr.
+     * @return the height of the node, 0 if nullptr.
+     */
+    static int height(const Node *node) {
+        return node ? node->height : 0;
+    }
+
+    /**
+     * @param key copied into the new node.
+     * @param left child of the new node.
+     * @param right child of the new node.
+     * @return new unpublished node, owned by the context of the write.
+     */
+    Node* makeNode(const T& key, Node *left, Node *right) {
+        auto& created{writing->created};
+
+        // the node must be recorded once built, so room is made before allocating it
+        if (created.size() == created.capacity()) {
+            created.reserve(2 * created.capacity() + 1);
+        }
+
+        Node *node{NodeTraits::allocate(node_allocator, 1)};
+
+        try {
+            NodeTraits::construct(node_allocator, node, key, left, right);
+        } catch (...) {
+            NodeTraits::deallocate(node_allocator, node, 1);
+            throw;
+        }
+
+        created.push_back(node);
+        return node;
+    }
+
+    /**
+     * @param node subtree reused by the new version.
+     * @return the node itself.
+     */
+    static Node* share(Node *node) {
+        return node;
+    }
+
+    /**
+     * @param node replaced in the new version, freed once no reader can reach it.
+     */
+    void replace(Node *node) {
+        writing->replaced.push_back(node);
+    }
+
+    /**
+     * @param handle new version of a subtree.
+     * @return its root.
+     */
+    static Node* address(Node *handle) {
+        return handle;
+    }
+
+    /**
+     * Runs a write, publishes its new root, & frees the nodes no reader can reach anymore.
+     * If the write throws, the published version is left untouched.
+     *
+     * @param current published root the write starts from.
+     * @param write builds the new version, returning its root.
+     */
+    template <typename Write>
+    void publish(const Node *current, Write&& write) {
+        WriteContext context;
+        std::vector<Node*> unlinked;
+        Node *new_root;
+
+        try {
+            // a write copies up to 3 nodes per level, a removal may double rotate at every level
+            const auto levels{static_cast<std::size_t>(height(current)) + 1};
+            context.created.reserve(3 * levels);
+            context.replaced.reserve(3 * levels);
+
+            // the batch is retired once the root is published, so room is made beforehand
+            if (retired.size() == retired.capacity()) {
+                retired.reserve(2 * retired.capacity() + 1);
+            }
+
+            writing = &context;
+            new_root = write();
+            writing = nullptr;
+            unlinked.reserve(context.replaced.size());
+        } catch (...) {
+            writing = nullptr;
+
+            for (Node *node: context.created) {
+                destroyNode(node);
+            }
+
+            throw;
+        }
+
+        root.store(new_root);
+
+        // nodes created & replaced within this write were never published
+        std::sort(context.created.begin(), context.created.end());
+
+        for (Node *node: context.replaced) {
+            if (std::binary_search(context.created.begin(), context.created.end(), node)) {
+                destroyNode(node);
+            } else {
+                unlinked.push_back(node);
+            }
+        }
+
+        retired.push_back({epochs.advance(), std::move(unlinked)});
+        reclaim();
+    }
+
+    /**
+     * Frees the batches retired before the oldest pinned epoch.
+     */
+    void reclaim() {
+        const std::uint64_t oldest{epochs.oldest_pinned()};
+
+        auto freed = [&](RetiredBatch& batch) {
+            if (oldest <= batch.epoch) {
+                return false;
+            }
+
+            for (Node *node: batch.nodes) {
+                destroyNode(node);
+            }
+
+            return true;
+        };
+
+        retired.erase(std::remove_if(retired.begin(), retired.end(), freed), retired.end());
+    }
+
+    /**
+     * @param node to be destroyed & returned to the allocator.
+     */
+    void destroyNode(Node *node) {
+        NodeTraits::destroy(node_allocator, node);
+        NodeTraits::deallocate(node_allocator, node, 1);
+    }
+
+    /**
+     * @param node root of a subtree to be destroyed.
+     */
+    void destroySubtree(Node *node) {
+        if (node) {
+            destroySubtree(node->left);
+            destroySubtree(node->right);
+            destroyNode(node);
+        }
+    }
+
+    /*
+     * Ordering of the keys.
+     */
+    Compare comparator;
+
+    /*
+     * Allocator for the nodes, only used by writers.
+     */
+    NodeAllocator node_allocator;
+
+    /*
+     * Root of the published version.
+     */
+    std::atomic<Node*> root{nullptr};
+
+    /*
+     * Number of keys in the published version.
+     */
+    std::atomic<size_type> count{0};
+
+    /*
+     * Serializes the writers.
+     */
+    std::mutex writer{};
+
+    /*
+     * Epochs pinned by the readers.
+     */
+    mutable EpochDomain epochs;
+
+    /*
+     * Nodes unlinked by past writes, waiting for their readers to finish. Only used by writers.
+     */
+    std::vector<RetiredBatch> retired{};
+
+    /*
+     * Context of the write in progress, nullptr between writes. Only used by writers.
+     */
+    WriteContext *writing{nullptr};
+};
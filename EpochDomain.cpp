@@ -0,0 +1,144 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+
+/**
+ * Epoch-based reclamation for structures whose readers never lock.
+ *
+ * Readers pin the current epoch for the duration of a read. A writer unlinks objects,
+ * then advances the epoch & tags them with the epoch they were unlinked in.
+ * Objects tagged before the oldest pinned epoch can no longer be reached, & may be freed.
+ */
+class EpochDomain {
+    /**
+     * Epoch pinned by one reader, 0 if free. Each slot has a cache line of its own.
+     */
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> epoch{0};
+    };
+public:
+    /**
+     * Pins an epoch while it is alive, readers must not keep pointers past it.
+     */
+    class Guard {
+    public:
+        Guard(const Guard&) = delete;
+
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard() {
+            slot->epoch.store(0, std::memory_order_release);
+        }
+    private:
+        friend class EpochDomain;
+
+        /**
+         * @param domain whose current epoch is pinned.
+         */
+        explicit Guard(const EpochDomain& domain) {
+            const std::size_t count{domain.slot_count};
+            std::size_t index{std::hash<std::thread::id>{}(std::this_thread::get_id()) % count};
+            const std::uint64_t epoch{domain.global_epoch.load()};
+
+            // claim a free slot, starting at the one of the thread
+            while (true) {
+                std::uint64_t expected{0};
+
+                if (domain.slots[index].epoch.compare_exchange_strong(expected, epoch)) {
+                    break;
+                }
+
+                index = (index + 1) % count;
+            }
+
+            slot = &domain.slots[index];
+        }
+
+        // Slot holding the pinned epoch.
+        Slot *slot;
+    };
+
+    /**
+     * @param slots maximum number of concurrent readers, others spin until a slot is free.
+     */
+    explicit EpochDomain(std::size_t slots = 128):
+        slot_count{slots ? slots : 1}, slots{std::make_unique<Slot[]>(slot_count)} {}
+
+    EpochDomain(const EpochDomain&) = delete;
+
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    /**
+     * @return guard pinning the current epoch.
+     */
+    [[nodiscard]] Guard pin() const {
+        return Guard(*this);
+    }
+
+    /**
+     * Called by the writer once the objects it unlinked are unreachable from the published state.
+     *
+     * @return tag of the unlinked objects.
+     */
+    std::uint64_t advance() {
+        return global_epoch.fetch_add(1);
+    }
+
+    /**
+     * @return oldest epoch still pinned, objects tagged before it can be freed.
+     */
+    [[nodiscard]] std::uint64_t oldest_pinned() const {
+        std::uint64_t oldest{global_epoch.load()};
+
+        for (std::size_t i{0}; i < slot_count; i++) {
+            const std::uint64_t epoch{slots[i].epoch.load()};
+
+            if (epoch) {
+                oldest = std::min(oldest, epoch);
+            }
+        }
+
+        return oldest;
+    }
+private:
+    // Current epoch, 0 is reserved for free slots.
+    std::atomic<std::uint64_t> global_epoch{1};
+
+    // Number of reader slots.
+    std::size_t slot_count;
+
+    // Reader slots.
+    std::unique_ptr<Slot[]> slots;
+};
@@ -0,0 +1,203 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+
+
+/**
+ * Eytzinger layout: the keys of a complete binary search tree stored in breadth-first order.
+ * Node k, counted from 1, has its children at 2k & 2k + 1 & is stored at index k - 1.
+ * A search touches one cache line per level at most, & the next levels can be prefetched,
+ * since the 16 descendants 4 levels below node k are contiguous, starting at node 16k.
+ */
+
+/**
+ * @param k node index, counted from 1, reached past a leaf.
+ * @return the last node the descent went left at, 0 if it never did.
+ */
+inline std::size_t eytzingerLastLeft(std::size_t k) {
+    // the trailing ones are the right turns after the last left turn
+#if defined(__GNUC__)
+    return k >> __builtin_ffsll(static_cast<long long>(~k));
+#else
+    while (k & 1) {
+        k >>= 1;
+    }
+
+    return k >> 1;
+#endif
+}
+
+/**
+ * @param keys in Eytzinger order.
+ * @param count number of keys.
+ * @param k node to prefetch the descendants of, 4 levels below.
+ */
+template <typename T>
+inline void eytzingerPrefetch(const T *keys, std::size_t count, std::size_t k) {
+#if defined(__GNUC__)
+    if (16 * k <= count) {
+        __builtin_prefetch(keys + 16 * k - 1);
+    }
+#else
+    (void) keys;
+    (void) count;
+    (void) k;
+#endif
+}
+
+/**
+ * Branchless search, a single comparison per level & no early exit.
+ *
+ * @param keys in Eytzinger order.
+ * @param count number of keys.
+ * @param key bound of the search.
+ * @param comp ordering of the keys.
+ * @return node of the first key not before key, counted from 1, 0 if there is none.
+ */
+template <typename T, typename K, typename Compare>
+std::size_t eytzingerLowerBound(const T *keys, std::size_t count, const K& key, const Compare& comp) {
+    std::size_t k{1};
+
+    while (k <= count) {
+        eytzingerPrefetch(keys, count, k);
+        k = 2 * k + static_cast<std::size_t>(comp(keys[k - 1], key));
+    }
+
+    return eytzingerLastLeft(k);
+}
+
+/**
+ * @param keys in Eytzinger order.
+ * @param count number of keys.
+ * @param key bound of the search.
+ * @param comp ordering of the keys.
+ * @return node of the first key after key, counted from 1, 0 if there is none.
+ */
+template <typename T, typename K, typename Compare>
+std::size_t eytzingerUpperBound(const T *keys, std::size_t count, const K& key, const Compare& comp) {
+    std::size_t k{1};
+
+    while (k <= count) {
+        eytzingerPrefetch(keys, count, k);
+        k = 2 * k + static_cast<std::size_t>(not comp(key, keys[k - 1]));
+    }
+
+    return eytzingerLastLeft(k);
+}
+
+/**
+ * Stores sorted keys in Eytzinger order, by an in-order walk of the implicit tree.
+ *
+ * @param first next sorted key, advanced past the stored keys.
+ * @param keys storage for count keys.
+ * @param count number of keys.
+ * @param k node of the subtree to fill.
+ */
+template <typename InputIt, typename T>
+void eytzingerFill(InputIt& first, T *keys, std::size_t count, std::size_t k = 1) {
+    if (k <= count) {
+        eytzingerFill(first, keys, count, 2 * k);
+        keys[k - 1] = *first;
+        ++first;
+        eytzingerFill(first, keys, count, 2 * k + 1);
+    }
+}
+
+/**
+ * @param k node index, counted from 1.
+ * @param count number of keys.
+ * @return number of nodes in the subtree of node k.
+ */
+inline std::size_t eytzingerSubtreeSize(std::size_t k, std::size_t count) {
+    std::size_t size{0};
+
+    // the subtree holds nodes [k * 2^l, (k + 1) * 2^l) on its l-th level
+    for (std::size_t width{1}; k <= count; k *= 2, width *= 2) {
+        size += std::min(width, count - k + 1);
+    }
+
+    return size;
+}
+
+/**
+ * Walks sorted keys in order, visiting the nodes between two depths & skipping the subtrees below them,
+ * by std::advance, in O(1) for random access iterators.
+ * The nodes of a single depth are visited in Eytzinger order.
+ *
+ * @param first next sorted key, advanced past the keys of the subtree.
+ * @param count number of keys.
+ * @param low depth of the first visited level, the root has depth 0.
+ * @param high depth of the last visited level.
+ * @param visit called with the node, counted from 1, & its key.
+ * @param k node of the subtree to walk.
+ * @param depth of node k.
+ */
+template <typename ForwardIt, typename Visit>
+void eytzingerVisitLevels(ForwardIt& first, std::size_t count, std::size_t low, std::size_t high, Visit& visit,
+                          std::size_t k = 1, std::size_t depth = 0) {
+    if (k > count) {
+        return;
+    }
+
+    if (depth == high) {
+        std::advance(first, eytzingerSubtreeSize(2 * k, count));
+
+        if (depth >= low) {
+            visit(k, *first);
+        }
+
+        std::advance(first, 1 + eytzingerSubtreeSize(2 * k + 1, count));
+        return;
+    }
+
+    eytzingerVisitLevels(first, count, low, high, visit, 2 * k, depth + 1);
+
+    if (depth >= low) {
+        visit(k, *first);
+    }
+
+    ++first;
+    eytzingerVisitLevels(first, count, low, high, visit, 2 * k + 1, depth + 1);
+}
+
+/**
+ * @param keys in Eytzinger order.
+ * @param count number of keys.
+ * @param visit called with every key, in sorted order.
+ * @param k node of the subtree to visit.
+ */
+template <typename T, typename Visit>
+void eytzingerVisit(const T *keys, std::size_t count, Visit& visit, std::size_t k = 1) {
+    if (k <= count) {
+        eytzingerVisit(keys, count, visit, 2 * k);
+        visit(keys[k - 1]);
+        eytzingerVisit(keys, count, visit, 2 * k + 1);
+    }
+}
@@ -0,0 +1,354 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "Eytzinger.cpp"
+
+#if defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define AVL_FROZEN_AVX2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AVL_FROZEN_NEON 1
+#endif
+
+
+/**
+ * Immutable snapshot of a tree stored in one contiguous array, produced by AVL::freeze().
+ * The source tree stays writable & can be frozen again once enough writes piled up.
+ *
+ * Arithmetic keys ordered by std::less are stored as a static B-tree: blocks of one cache
+ * line of keys, each with one child block per gap, laid out breadth first. A search touches
+ * one line per level, and the keys of a block are compared all at once, with AVX2 or NEON
+ * for 32-bit integers & floats when available. Other keys are stored in Eytzinger order
+ * & searched branchlessly with prefetching.
+ *
+ * @tparam T type of the keys.
+ * @tparam Compare strict weak ordering of the keys.
+ */
+template <typename T, typename Compare = std::less<T>>
+class FrozenAVL {
+public:
+    /* Custom size type for the AVL tree */
+    typedef long long size_type;
+
+    /**
+     * @param first start of the keys, sorted & without duplicates.
+     * @param count number of keys.
+     * @param comp ordering of the keys.
+     */
+    template <typename InputIt>
+    FrozenAVL(InputIt first, std::size_t count, const Compare& comp = Compare()): comparator{comp}, count{count} {
+        if constexpr (blocked) {
+            block_count = (count + block_keys - 1) / block_keys;
+            keys.assign(block_count, Block{});
+            std::size_t filled{0};
+            fillBlocks(first, filled, 0);
+        } else {
+            keys.resize(count);
+            eytzingerFill(first, keys.data(), count);
+        }
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return pointer to the key equivalent to value, nullptr if absent.
+     */
+    [[nodiscard]] const T* search(const T& value) const {
+        const T *candidate{lower_bound(value)};
+        return candidate and not comparator(value, *candidate) ? candidate : nullptr;
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return true if the value is present.
+     */
+    [[nodiscard]] bool contains(const T& value) const {
+        return search(value);
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return pointer to the first key not before value, nullptr if there is none.
+     */
+    [[nodiscard]] const T* lower_bound(const T& value) const {
+        if constexpr (blocked) {
+            // past the largest key, the bound would land on padding
+            if (not count or comparator(*largest(), value)) {
+                return nullptr;
+            }
+
+            return boundInBlocks<false>(value);
+        } else {
+            const auto k{eytzingerLowerBound(keys.data(), count, value, comparator)};
+            return k ? keys.data() + k - 1 : nullptr;
+        }
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return pointer to the first key after value, nullptr if there is none.
+     */
+    [[nodiscard]] const T* upper_bound(const T& value) const {
+        if constexpr (blocked) {
+            if (not count or not comparator(value, *largest())) {
+                return nullptr;
+            }
+
+            return boundInBlocks<true>(value);
+        } else {
+            const auto k{eytzingerUpperBound(keys.data(), count, value, comparator)};
+            return k ? keys.data() + k - 1 : nullptr;
+        }
+    }
+
+    /**
+     * @param visit called with every key, in order.
+     */
+    template <typename Visit>
+    void for_each(Visit&& visit) const {
+        if constexpr (blocked) {
+            std::size_t visited{0};
+            visitBlocks(visit, visited, 0);
+        } else {
+            eytzingerVisit(keys.data(), count, visit);
+        }
+    }
+
+    /**
+     * @return number of keys.
+     */
+    [[nodiscard]] size_type size() const {
+        return static_cast<size_type>(count);
+    }
+
+    /**
+     * @return true if the tree holds no key.
+     */
+    [[nodiscard]] bool empty() const {
+        return not count;
+    }
+private:
+    // True if the keys are stored as a static B-tree, which pads blocks with the largest value.
+    static constexpr bool blocked{std::is_arithmetic_v<T> and std::is_same_v<Compare, std::less<T>>};
+
+    // Number of keys in one block, one cache line.
+    static constexpr std::size_t block_keys{sizeof(T) < 64 ? 64 / sizeof(T) : 1};
+
+    /**
+     * Cache line of keys, sorted, the unused tail holds padding.
+     */
+    struct alignas(64) Block {
+        T keys[block_keys];
+
+        Block() {
+            for (auto& key: keys) {
+                key = padding();
+            }
+        }
+    };
+
+    /**
+     * @return value of the unused slots, after every key.
+     */
+    static constexpr T padding() {
+        if constexpr (std::numeric_limits<T>::has_infinity) {
+            return std::numeric_limits<T>::infinity();
+        } else {
+            return std::numeric_limits<T>::max();
+        }
+    }
+
+    /**
+     * @param k index of a block.
+     * @param i index of a gap in the block, in [0, block_keys].
+     * @return index of the child block under the gap.
+     */
+    static constexpr std::size_t child(std::size_t k, std::size_t i) {
+        return k * (block_keys + 1) + i + 1;
+    }
+
+    /**
+     * @tparam inclusive count the keys equal to value too.
+     * @param block to be scanned.
+     * @param value compared to the keys.
+     * @return number of keys of the block before value, or not after it if inclusive.
+     */
+    template <bool inclusive>
+    static std::size_t rankInBlock(const Block& block, const T& value) {
+#if defined(AVL_FROZEN_AVX2)
+        if constexpr (std::is_same_v<T, std::int32_t>) {
+            const __m256i probe{_mm256_set1_epi32(value)};
+            const __m256i low{_mm256_load_si256(reinterpret_cast<const __m256i*>(block.keys))};
+            const __m256i high{_mm256_load_si256(reinterpret_cast<const __m256i*>(block.keys + 8))};
+
+            if constexpr (inclusive) {
+                // keys not after value are the ones not greater than it
+                const auto greater{static_cast<unsigned>(
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(low, probe))) |
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(high, probe))) << 8)};
+                return block_keys - __builtin_popcount(greater);
+            } else {
+                const auto less{static_cast<unsigned>(
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(probe, low))) |
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(probe, high))) << 8)};
+                return __builtin_popcount(less);
+            }
+        } else if constexpr (std::is_same_v<T, float>) {
+            constexpr int predicate{inclusive ? _CMP_LE_OQ : _CMP_LT_OQ};
+            const __m256 probe{_mm256_set1_ps(value)};
+            const __m256 low{_mm256_load_ps(block.keys)};
+            const __m256 high{_mm256_load_ps(block.keys + 8)};
+            const auto before{static_cast<unsigned>(
+                _mm256_movemask_ps(_mm256_cmp_ps(low, probe, predicate)) |
+                _mm256_movemask_ps(_mm256_cmp_ps(high, probe, predicate)) << 8)};
+            return __builtin_popcount(before);
+        }
+#elif defined(AVL_FROZEN_NEON)
+        if constexpr (std::is_same_v<T, std::int32_t>) {
+            const int32x4_t probe{vdupq_n_s32(value)};
+            int32x4_t before{vdupq_n_s32(0)};
+
+            // matching lanes are all ones, -1 as signed integers
+            for (std::size_t i{0}; i < block_keys; i += 4) {
+                const int32x4_t lanes{vld1q_s32(block.keys + i)};
+                const uint32x4_t match{inclusive ? vcleq_s32(lanes, probe) : vcltq_s32(lanes, probe)};
+                before = vaddq_s32(before, vreinterpretq_s32_u32(match));
+            }
+
+            return static_cast<std::size_t>(-vaddvq_s32(before));
+        }
+#endif
+        // counting instead of searching keeps the loop free of branches
+        std::size_t rank{0};
+
+        for (std::size_t i{0}; i < block_keys; i++) {
+            rank += inclusive ? not (value < block.keys[i]) : block.keys[i] < value;
+        }
+
+        return rank;
+    }
+
+    /**
+     * Needs a bound among the keys, the padding is never returned.
+     *
+     * @tparam after search for the first key after value, instead of not before it.
+     * @param value bound of the search.
+     * @return pointer to the bound.
+     */
+    template <bool after>
+    const T* boundInBlocks(const T& value) const {
+        const T *bound{nullptr};
+
+        for (std::size_t k{0}; k < block_count;) {
+            const Block& block{keys[k]};
+            const std::size_t i{rankInBlock<after>(block, value)};
+
+            // the deepest block with a key past value holds the bound
+            bound = i < block_keys ? block.keys + i : bound;
+            k = child(k, i);
+        }
+
+        return bound;
+    }
+
+    /**
+     * @return pointer to the largest key, needs a non-empty tree.
+     */
+    const T* largest() const {
+        return keys[largest_slot / block_keys].keys + largest_slot % block_keys;
+    }
+
+    /**
+     * Stores the keys in order into the subtree of the block, padding the slots left over.
+     *
+     * @param first next key to be stored.
+     * @param filled number of keys already stored.
+     * @param k index of the block.
+     */
+    template <typename InputIt>
+    void fillBlocks(InputIt& first, std::size_t& filled, std::size_t k) {
+        if (k >= block_count) {
+            return;
+        }
+
+        for (std::size_t i{0}; i < block_keys; i++) {
+            fillBlocks(first, filled, child(k, i));
+
+            if (filled < count) {
+                keys[k].keys[i] = *first;
+                ++first;
+                largest_slot = k * block_keys + i;
+                filled++;
+            }
+        }
+
+        fillBlocks(first, filled, child(k, block_keys));
+    }
+
+    /**
+     * @param visit called with the keys of the subtree, in order.
+     * @param visited number of keys already visited.
+     * @param k index of the block.
+     */
+    template <typename Visit>
+    void visitBlocks(Visit& visit, std::size_t& visited, std::size_t k) const {
+        if (k >= block_count) {
+            return;
+        }
+
+        for (std::size_t i{0}; i < block_keys; i++) {
+            visitBlocks(visit, visited, child(k, i));
+
+            if (visited < count) {
+                visit(keys[k].keys[i]);
+                visited++;
+            }
+        }
+
+        visitBlocks(visit, visited, child(k, block_keys));
+    }
+
+    // Ordering of the keys.
+    Compare comparator;
+
+    // Number of keys.
+    std::size_t count;
+
+    // Static B-tree blocks, or keys in Eytzinger order.
+    std::conditional_t<blocked, std::vector<Block>, std::vector<T>> keys{};
+
+    // Number of blocks & slot of the largest key, for the blocked layout.
+    std::size_t block_count{0};
+    std::size_t largest_slot{0};
+};
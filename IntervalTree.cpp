@@ -0,0 +1,196 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "AvlTree.cpp"
+
+
+/**
+ * Closed interval [low, high].
+ *
+ * @tparam P type of the endpoints, totally ordered by operator<.
+ */
+template <typename P>
+struct Interval {
+    P low;
+    P high;
+
+    /**
+     * @param other interval to compare with.
+     * @return true if both intervals share at least one point.
+     */
+    [[nodiscard]] bool overlaps(const Interval& other) const {
+        return not (high < other.low) and not (other.high < low);
+    }
+
+    /**
+     * Intervals are ordered by their low endpoint, then by their high endpoint.
+     */
+    friend bool operator<(const Interval& lhs, const Interval& rhs) {
+        return lhs.low < rhs.low or (not (rhs.low < lhs.low) and lhs.high < rhs.high);
+    }
+
+    friend bool operator==(const Interval& lhs, const Interval& rhs) {
+        return not (lhs < rhs) and not (rhs < lhs);
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const Interval& interval) {
+        return out << '[' << interval.low << ", " << interval.high << ']';
+    }
+};
+
+/**
+ * Largest high endpoint of the intervals in each subtree.
+ *
+ * @tparam P type of the endpoints.
+ */
+template <typename P>
+struct MaxEndpointAugmentation {
+    struct summary_type {
+        P max_high;
+
+        // False for the summary of no interval.
+        bool present;
+    };
+
+    static summary_type identity() {
+        return {P{}, false};
+    }
+
+    static summary_type lift(const Interval<P>& interval) {
+        return {interval.high, true};
+    }
+
+    static summary_type combine(const summary_type& a, const summary_type& b) {
+        if (not a.present) {
+            return b;
+        }
+
+        if (not b.present) {
+            return a;
+        }
+
+        return a.max_high < b.max_high ? b : a;
+    }
+};
+
+/**
+ * @tparam P type of the endpoints.
+ */
+template <typename P>
+struct IntervalNodePolicy: AugmentedNodePolicy<MaxEndpointAugmentation<P>> {};
+
+/**
+ * AVL tree of closed intervals, augmented with the largest high endpoint of every subtree.
+ * Overlap queries skip every subtree ending before the query, in O(log n + k) for k results.
+ *
+ * @tparam P type of the endpoints.
+ * @tparam Allocator std::allocator-compatible allocator, rebound to allocate the nodes.
+ */
+template <typename P, typename Allocator = std::allocator<Interval<P>>>
+class IntervalTree: public AVL<Interval<P>, std::less<Interval<P>>, Allocator, IntervalNodePolicy<P>> {
+public:
+    using Base = AVL<Interval<P>, std::less<Interval<P>>, Allocator, IntervalNodePolicy<P>>;
+    using Base::Base;
+
+    /**
+     * @param query interval to be overlapped.
+     * @param visit called with every stored interval overlapping the query, in order.
+     */
+    template <typename Visit>
+    void for_each_overlapping(const Interval<P>& query, Visit&& visit) const {
+        visitOverlapping(this->getRoot(), query, visit);
+    }
+
+    /**
+     * @param query interval to be overlapped.
+     * @return every stored interval overlapping the query, in order.
+     */
+    [[nodiscard]] std::vector<Interval<P>> overlapping(const Interval<P>& query) const {
+        std::vector<Interval<P>> result;
+        for_each_overlapping(query, [&](const Interval<P>& interval) { result.push_back(interval); });
+        return result;
+    }
+
+    /**
+     * @param point to be stabbed.
+     * @return every stored interval containing the point, in order.
+     */
+    [[nodiscard]] std::vector<Interval<P>> stabbing(const P& point) const {
+        return overlapping({point, point});
+    }
+
+    /**
+     * @param query interval to be overlapped.
+     * @return true if any stored interval overlaps the query, in O(log n).
+     */
+    [[nodiscard]] bool any_overlapping(const Interval<P>& query) const {
+        Node *node{this->getRoot()};
+
+        while (node and not node->key.overlaps(query)) {
+            Node *left{node->left};
+
+            // if the left subtree reaches the query but misses it, so does everything on the right
+            node = left and not (left->summary.max_high < query.low) ? left : static_cast<Node*>(node->right);
+        }
+
+        return node;
+    }
+private:
+    using Node = typename Base::Node;
+
+    /**
+     * @param node root of a subtree, may be nullptr.
+     * @param query interval to be overlapped.
+     * @param visit called with every interval of the subtree overlapping the query.
+     */
+    template <typename Visit>
+    static void visitOverlapping(Node *node, const Interval<P>& query, Visit& visit) {
+        // no interval of the subtree reaches the query
+        if (not node or node->summary.max_high < query.low) {
+            return;
+        }
+
+        visitOverlapping(node->left, query, visit);
+
+        // every interval from here on starts after the query
+        if (query.high < node->key.low) {
+            return;
+        }
+
+        if (not (node->key.high < query.low)) {
+            visit(node->key);
+        }
+
+        visitOverlapping(node->right, query, visit);
+    }
+};
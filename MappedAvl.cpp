@@ -0,0 +1,217 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "AvlImage.cpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define AVL_HAS_MMAP 1
+#else
+#define AVL_HAS_MMAP 0
+#endif
+
+
+/**
+ * Read-only tree answering lookups straight from an image written by AVL::save(),
+ * without deserializing it. Files are memory-mapped where POSIX mmap is available,
+ * so processes mapping the same image share it through the page cache.
+ *
+ * @tparam T type of the keys, trivially copyable, as saved.
+ * @tparam Compare strict weak ordering of the keys, the one the image was saved with.
+ */
+template <typename T, typename Compare = std::less<T>>
+class MappedAVL {
+public:
+    /* Custom size type for the AVL tree */
+    typedef long long size_type;
+
+    /**
+     * @param path of the image to be mapped.
+     * @param comp ordering of the keys.
+     * @throws runtime_error if the file cannot be read or is not an image of T.
+     */
+    explicit MappedAVL(const std::string& path, const Compare& comp = Compare()): comparator{comp} {
+#if AVL_HAS_MMAP
+        const int descriptor{::open(path.c_str(), O_RDONLY)};
+
+        if (descriptor < 0) {
+            throw std::runtime_error("MappedAVL: cannot open " + path);
+        }
+
+        struct stat status{};
+
+        if (::fstat(descriptor, &status) != 0) {
+            ::close(descriptor);
+            throw std::runtime_error("MappedAVL: cannot stat " + path);
+        }
+
+        mapped_bytes = static_cast<std::size_t>(status.st_size);
+        void *address{mapped_bytes ? ::mmap(nullptr, mapped_bytes, PROT_READ, MAP_SHARED, descriptor, 0) : MAP_FAILED};
+        ::close(descriptor);
+
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("MappedAVL: cannot map " + path);
+        }
+
+        mapping = address;
+
+        try {
+            keys = readAvlImage<T>(mapping, mapped_bytes, count);
+        } catch (...) {
+            ::munmap(mapping, mapped_bytes);
+            throw;
+        }
+#else
+        // no mmap, the image is read into an aligned buffer instead
+        std::ifstream in{path, std::ios::binary | std::ios::ate};
+
+        if (not in) {
+            throw std::runtime_error("MappedAVL: cannot open " + path);
+        }
+
+        const auto bytes{static_cast<std::size_t>(in.tellg())};
+        buffer.reset(new std::max_align_t[bytes / sizeof(std::max_align_t) + 1]);
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(buffer.get()), static_cast<std::streamsize>(bytes));
+
+        if (not in) {
+            throw std::runtime_error("MappedAVL: cannot read " + path);
+        }
+
+        keys = readAvlImage<T>(buffer.get(), bytes, count);
+#endif
+    }
+
+    /**
+     * @param data image in memory, which must outlive the tree.
+     * @param bytes size of the image.
+     * @param comp ordering of the keys.
+     * @throws runtime_error if the memory is not an image of T.
+     */
+    MappedAVL(const void *data, std::size_t bytes, const Compare& comp = Compare()): comparator{comp} {
+        keys = readAvlImage<T>(data, bytes, count);
+    }
+
+    MappedAVL(const MappedAVL&) = delete;
+
+    MappedAVL& operator=(const MappedAVL&) = delete;
+
+    MappedAVL(MappedAVL&& other) noexcept:
+        comparator{other.comparator}, keys{std::exchange(other.keys, nullptr)}, count{std::exchange(other.count, 0)},
+        mapping{std::exchange(other.mapping, nullptr)}, mapped_bytes{std::exchange(other.mapped_bytes, 0)},
+        buffer{std::move(other.buffer)} {}
+
+    ~MappedAVL() {
+#if AVL_HAS_MMAP
+        if (mapping) {
+            ::munmap(mapping, mapped_bytes);
+        }
+#endif
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return pointer to the key equivalent to value inside the image, nullptr if absent.
+     */
+    [[nodiscard]] const T* search(const T& value) const {
+        const T *candidate{lower_bound(value)};
+        return candidate and not comparator(value, *candidate) ? candidate : nullptr;
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return true if the value is present.
+     */
+    [[nodiscard]] bool contains(const T& value) const {
+        return search(value);
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return pointer to the first key not before value, nullptr if there is none.
+     */
+    [[nodiscard]] const T* lower_bound(const T& value) const {
+        const auto k{eytzingerLowerBound(keys, count, value, comparator)};
+        return k ? keys + k - 1 : nullptr;
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return pointer to the first key after value, nullptr if there is none.
+     */
+    [[nodiscard]] const T* upper_bound(const T& value) const {
+        const auto k{eytzingerUpperBound(keys, count, value, comparator)};
+        return k ? keys + k - 1 : nullptr;
+    }
+
+    /**
+     * @param visit called with every key, in order.
+     */
+    template <typename Visit>
+    void for_each(Visit&& visit) const {
+        eytzingerVisit(keys, count, visit);
+    }
+
+    /**
+     * @return number of keys.
+     */
+    [[nodiscard]] size_type size() const {
+        return static_cast<size_type>(count);
+    }
+
+    /**
+     * @return true if the image holds no key.
+     */
+    [[nodiscard]] bool empty() const {
+        return not count;
+    }
+private:
+    // Ordering of the keys.
+    Compare comparator;
+
+    // Keys in Eytzinger order, inside the image.
+    const T *keys{nullptr};
+    std::size_t count{0};
+
+    // Mapped file, nullptr for an image given in memory.
+    void *mapping{nullptr};
+    std::size_t mapped_bytes{0};
+
+    // Copy of the file where mmap is not available.
+    std::unique_ptr<std::max_align_t[]> buffer{};
+};
@@ -0,0 +1,311 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+
+/**
+ * 32-bit link to a node, stored as a signed offset from the address of the link itself.
+ * Behaves like a N* for reads & assignments, but cannot be copy-constructed,
+ * since a copy living elsewhere would not point to the same node.
+ *
+ * The linked node must lie within reach of the link, +-8 GiB.
+ * AVL only accepts such links with a PoolAllocator, whose pool it bounds to that span,
+ * see NodePool::bound_span(), so no link between two of its nodes can overflow.
+ *
+ * @tparam N type of the linked node.
+ */
+template <typename N>
+class RelativeLink {
+public:
+    /**
+     * @param target node to link to, nullptr for no node.
+     */
+    RelativeLink(N *target = nullptr) noexcept {
+        *this = target;
+    }
+
+    RelativeLink(const RelativeLink&) = delete;
+
+    /*
+     * Largest distance between a link & its node, in bytes, in either direction.
+     */
+    static constexpr std::uint64_t reach{
+        static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max()) * alignof(std::int32_t)
+    };
+
+    /**
+     * @param target node to link to, nullptr for no node.
+     * @return reference to this link.
+     */
+    RelativeLink& operator=(N *target) noexcept {
+        if (not target) {
+            offset = 0;
+            return *this;
+        }
+
+        const auto distance{reinterpret_cast<std::intptr_t>(target) - reinterpret_cast<std::intptr_t>(this)};
+
+        assert(distance % granularity == 0);
+        assert(std::numeric_limits<std::int32_t>::min() <= distance / granularity);
+        assert(distance / granularity <= std::numeric_limits<std::int32_t>::max());
+
+        offset = static_cast<std::int32_t>(distance / granularity);
+        return *this;
+    }
+
+    /**
+     * @param other link whose node is to be linked to.
+     * @return reference to this link.
+     */
+    RelativeLink& operator=(const RelativeLink& other) noexcept {
+        return *this = other.get();
+    }
+
+    /**
+     * @return pointer to the linked node, nullptr if there is none.
+     */
+    [[nodiscard]] N* get() const noexcept {
+        if (not offset) {
+            return nullptr;
+        }
+
+        return reinterpret_cast<N*>(reinterpret_cast<std::intptr_t>(this) + std::intptr_t{offset} * granularity);
+    }
+
+    operator N*() const noexcept {
+        return get();
+    }
+
+    N* operator->() const noexcept {
+        return get();
+    }
+private:
+    // Offsets are counted in units of the link alignment, a node can never start at the link itself.
+    static constexpr std::intptr_t granularity{alignof(std::int32_t)};
+
+    // Distance to the linked node in granularity units, 0 for no node.
+    std::int32_t offset;
+};
+
+/**
+ * Parent link of a node, empty unless the node policy enables parent links.
+ *
+ * @tparam Link type of the link to the parent node.
+ * @tparam Enabled true to store the link.
+ */
+template <typename Link, bool Enabled>
+struct NodeParentField {
+    /*
+     * Link to the parent node, nullptr for the root.
+     */
+    Link parent{nullptr};
+};
+
+template <typename Link>
+struct NodeParentField<Link, false> {};
+
+/**
+ * Number of nodes in the subtree of a node, empty unless the node policy counts them.
+ *
+ * @tparam Count type of the counter, void to store nothing.
+ */
+template <typename Count>
+struct NodeSizeField {
+    /*
+     * Number of nodes in the subtree whose root is this node, itself included.
+     */
+    Count size{1};
+};
+
+template <>
+struct NodeSizeField<void> {};
+
+/**
+ * Summary of the keys in the subtree of a node, empty unless the node policy has an augmentation.
+ *
+ * @tparam Augmentation monoid describing the summary, void to store nothing.
+ */
+template <typename Augmentation>
+struct NodeSummaryField {
+    /*
+     * Summary of the keys in the subtree whose root is this node, in order.
+     */
+    typename Augmentation::summary_type summary{};
+};
+
+template <>
+struct NodeSummaryField<void> {};
+
+/**
+ * Node layout policies, selecting the field types of AVL::Node at compile time.
+ *
+ * height_type: type of the height field, any AVL height fits in a signed char.
+ * link_type<N>: type of the child links, N* or any type behaving like it.
+ * parent_links: true to store a link to the parent in each node,
+ *               making iterator increments amortized O(1) instead of O(log n).
+ * subtree_size_type: type of the subtree node counter, void for none.
+ *                    Counting makes size(), rank(), select() & count_range() O(log n).
+ * augmentation: monoid summarizing the keys of each subtree, void for none.
+ *               It provides a summary_type, identity() its neutral element,
+ *               lift(key) the summary of a single key, & combine(a, b) an associative operation,
+ *               applied to adjacent summaries in key order. aggregate() is O(log n) with it.
+ */
+
+/**
+ * Wide height field & plain child pointers.
+ */
+struct DefaultNodePolicy {
+    using height_type = long long;
+
+    template <typename N>
+    using link_type = N*;
+
+    static constexpr bool parent_links{false};
+
+    using subtree_size_type = void;
+
+    using augmentation = void;
+};
+
+/**
+ * Default layout with parent pointers.
+ */
+struct ParentNodePolicy: DefaultNodePolicy {
+    static constexpr bool parent_links{true};
+};
+
+/**
+ * One byte height field & plain child pointers, usable with any allocator.
+ */
+struct CompactHeightNodePolicy: DefaultNodePolicy {
+    using height_type = signed char;
+};
+
+/**
+ * One byte height field & 32-bit relative child links.
+ * A tree of int takes 16 bytes per node instead of 32, the nodes must come from a PoolAllocator.
+ */
+struct CompactNodePolicy: DefaultNodePolicy {
+    using height_type = signed char;
+
+    template <typename N>
+    using link_type = RelativeLink<N>;
+};
+
+/**
+ * Compact layout with relative parent links.
+ */
+struct CompactParentNodePolicy: CompactNodePolicy {
+    static constexpr bool parent_links{true};
+};
+
+/**
+ * Default layout with subtree sizes, for order-statistic queries.
+ */
+struct OrderStatisticNodePolicy: DefaultNodePolicy {
+    using subtree_size_type = long long;
+};
+
+/**
+ * Compact layout with 32-bit subtree sizes, capping the tree at 2^32 - 1 nodes.
+ */
+struct CompactOrderStatisticNodePolicy: CompactNodePolicy {
+    using subtree_size_type = std::uint32_t;
+};
+
+/**
+ * Sum of the keys, or of any value they convert to.
+ *
+ * @tparam V type of the sums.
+ */
+template <typename V>
+struct SumAugmentation {
+    using summary_type = V;
+
+    static summary_type identity() {
+        return V{};
+    }
+
+    template <typename K>
+    static summary_type lift(const K& key) {
+        return static_cast<V>(key);
+    }
+
+    static summary_type combine(const summary_type& a, const summary_type& b) {
+        return a + b;
+    }
+};
+
+/**
+ * Smallest & largest key of each subtree.
+ *
+ * @tparam V type of the keys.
+ */
+template <typename V>
+struct MinMaxAugmentation {
+    struct summary_type {
+        V min;
+        V max;
+
+        // False for the summary of no key.
+        bool present;
+    };
+
+    static summary_type identity() {
+        return {V{}, V{}, false};
+    }
+
+    template <typename K>
+    static summary_type lift(const K& key) {
+        return {key, key, true};
+    }
+
+    static summary_type combine(const summary_type& a, const summary_type& b) {
+        if (not a.present) {
+            return b;
+        }
+
+        if (not b.present) {
+            return a;
+        }
+
+        return {b.min < a.min ? b.min : a.min, a.max < b.max ? b.max : a.max, true};
+    }
+};
+
+/**
+ * Default layout with a summary of each subtree.
+ *
+ * @tparam Augmentation monoid describing the summaries.
+ */
+template <typename Augmentation>
+struct AugmentedNodePolicy: DefaultNodePolicy {
+    using augmentation = Augmentation;
+};
@@ -0,0 +1,476 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define AVL_HAS_MMAP 1
+#else
+#define AVL_HAS_MMAP 0
+#endif
+
+
+/**
+ * Slab allocator handing out fixed-size slots carved from large contiguous chunks.
+ *
+ * The slot layout is fixed by the first allocation, slots are exactly one object wide
+ * so contiguous slots form an array. Requests for any other layout, or for objects
+ * too small to hold a free-list link, are forwarded to the global operator new.
+ * Not thread-safe.
+ */
+class NodePool {
+public:
+    /**
+     * FreeList: deallocated slots are recycled by later allocations.
+     * Arena: deallocation is a no-op, memory is only reclaimed all at once
+     *        by release() or by destroying the pool.
+     */
+    enum class Mode {
+        FreeList,
+        Arena,
+    };
+
+    /**
+     * @param mode recycling mode of the pool.
+     * @param slots_per_chunk number of slots in each chunk requested from the system.
+     */
+    explicit NodePool(Mode mode = Mode::FreeList, std::size_t slots_per_chunk = 1024):
+        pool_mode{mode}, chunk_slots{slots_per_chunk ? slots_per_chunk : 1} {}
+
+    NodePool(const NodePool&) = delete;
+
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool() {
+        release();
+    }
+
+    /**
+     * @param bytes size of one object.
+     * @param alignment alignment of one object.
+     * @param count number of contiguous objects.
+     * @return pointer to storage for count contiguous objects.
+     */
+    void* allocate(std::size_t bytes, std::size_t alignment, std::size_t count = 1) {
+        if (slot_size == 0) {
+            // first allocation decides the slot layout
+            slot_size = bytes;
+            slot_align = alignment;
+        }
+
+        if (not pooled(bytes, alignment)) {
+            return ::operator new(bytes * count, std::align_val_t(alignment));
+        }
+
+        // single slot, reuse a freed one if possible
+        if (count == 1 and free_list) {
+            std::byte *slot{free_list};
+            std::memcpy(&free_list, slot, sizeof(free_list));
+            return slot;
+        }
+
+        if (chunk_left < count) {
+            // the tail of the current chunk is too short for the block, its slots are recycled one by one
+            for (; chunk_left; chunk_left--, cursor += slot_size) {
+                std::memcpy(cursor, &free_list, sizeof(free_list));
+                free_list = cursor;
+            }
+
+            const std::size_t slots{count < chunk_slots ? chunk_slots : count};
+            cursor = newChunk(slots * slot_size);
+            chunk_left = slots;
+            reserved_bytes += slots * slot_size;
+        }
+
+        void *result{cursor};
+        cursor += count * slot_size;
+        chunk_left -= count;
+
+        return result;
+    }
+
+    /**
+     * @param pointer storage previously returned by allocate().
+     * @param bytes size of one object.
+     * @param alignment alignment of one object.
+     * @param count number of contiguous objects.
+     */
+    void deallocate(void *pointer, std::size_t bytes, std::size_t alignment, std::size_t count = 1) noexcept {
+        if (not pooled(bytes, alignment)) {
+            ::operator delete(pointer, std::align_val_t(alignment));
+            return;
+        }
+
+        if (pool_mode == Mode::Arena) {
+            return;
+        }
+
+        // every slot of a contiguous block can be recycled individually
+        auto *slot{static_cast<std::byte*>(pointer)};
+
+        for (std::size_t i{0}; i < count; i++, slot += slot_size) {
+            std::memcpy(slot, &free_list, sizeof(free_list));
+            free_list = slot;
+        }
+    }
+
+    /**
+     * Fixes the slot layout & keeps every chunk within span bytes, from the start of the lowest one
+     * to the end of the highest one, so that offsets between any two slots fit in fewer bits.
+     * Where mmap is available & no chunk exists yet, the span is reserved as one region of address space,
+     * whose pages are only committed as chunks are carved from it.
+     * Otherwise chunks come from operator new, & those that would spread the chunks further are released.
+     * Either way, a chunk allocation that breaks the bound fails with bad_alloc.
+     *
+     * @param bytes size of one object.
+     * @param alignment alignment of one object.
+     * @param span largest distance between the chunks, in bytes.
+     * @return false if the pool already serves another layout, or its chunks already spread further.
+     */
+    [[nodiscard]] bool bound_span(std::size_t bytes, std::size_t alignment, std::size_t span) noexcept {
+        if (slot_size == 0) {
+            slot_size = bytes;
+            slot_align = alignment;
+        }
+
+        if (not pooled(bytes, alignment) or (not chunks.empty() and span < chunks_high - chunks_low)) {
+            return false;
+        }
+
+        // a region already reserved cannot shrink
+        if (region and span < span_limit) {
+            return false;
+        }
+
+        region_allowed = region_allowed or (chunks.empty() and not region_used);
+        span_limit = std::min(span_limit, span);
+        return true;
+    }
+
+    /**
+     * Releases every chunk at once. All storage handed out by the pool becomes invalid.
+     */
+    void release() noexcept {
+        for (auto *chunk: chunks) {
+            ::operator delete(chunk, std::align_val_t(slot_align));
+        }
+
+#if AVL_HAS_MMAP
+        if (region) {
+            ::munmap(region, region_bytes);
+        }
+#endif
+
+        region = nullptr;
+        region_used = 0;
+        region_committed = 0;
+
+        chunks.clear();
+        chunks_low = UINTPTR_MAX;
+        chunks_high = 0;
+        reserved_bytes = 0;
+        free_list = nullptr;
+        cursor = nullptr;
+        chunk_left = 0;
+    }
+
+    /**
+     * @return recycling mode of the pool.
+     */
+    [[nodiscard]] Mode mode() const noexcept {
+        return pool_mode;
+    }
+
+    /**
+     * @return number of slots in each chunk requested from the system.
+     */
+    [[nodiscard]] std::size_t slots_per_chunk() const noexcept {
+        return chunk_slots;
+    }
+
+    /**
+     * @return number of bytes currently requested from the system.
+     */
+    [[nodiscard]] std::size_t reserved() const noexcept {
+        return reserved_bytes;
+    }
+private:
+    /**
+     * @param bytes size of one object.
+     * @param alignment alignment of one object.
+     * @return true if such objects are served from the slots.
+     */
+    [[nodiscard]] bool pooled(std::size_t bytes, std::size_t alignment) const noexcept {
+        return bytes == slot_size and alignment == slot_align and sizeof(std::byte*) <= bytes;
+    }
+
+    /**
+     * @param bytes size of the chunk, a multiple of the slot size.
+     * @return storage for the chunk, within the span of the other chunks.
+     * @throws bad_alloc if the storage cannot be had within the span.
+     */
+    std::byte* newChunk(std::size_t bytes) {
+        if (region_allowed) {
+            if (std::byte *chunk{regionChunk(bytes)}) {
+                return chunk;
+            }
+        }
+
+        auto *chunk{static_cast<std::byte*>(::operator new(bytes, std::align_val_t(slot_align)))};
+        const auto low{std::min(chunks_low, reinterpret_cast<std::uintptr_t>(chunk))};
+        const auto high{std::max(chunks_high, reinterpret_cast<std::uintptr_t>(chunk) + bytes)};
+
+        if (span_limit < high - low) {
+            ::operator delete(chunk, std::align_val_t(slot_align));
+            throw std::bad_alloc();
+        }
+
+        chunks.push_back(chunk);
+        chunks_low = low;
+        chunks_high = high;
+
+        return chunk;
+    }
+
+    /**
+     * @param bytes size of the chunk.
+     * @return storage for the chunk carved from the reserved region, nullptr if no region can be reserved.
+     * @throws bad_alloc if the region is exhausted or its pages cannot be committed.
+     */
+    std::byte* regionChunk([[maybe_unused]] std::size_t bytes) {
+#if AVL_HAS_MMAP
+        const auto page{static_cast<std::size_t>(::sysconf(_SC_PAGESIZE))};
+
+        if (not region) {
+            void *reserved{page < slot_align ? MAP_FAILED :
+                           ::mmap(nullptr, span_limit, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)};
+
+            if (reserved == MAP_FAILED) {
+                region_allowed = false;
+                return nullptr;
+            }
+
+            region = static_cast<std::byte*>(reserved);
+            region_bytes = span_limit;
+        }
+
+        const std::size_t start{(region_used + slot_align - 1) / slot_align * slot_align};
+
+        if (region_bytes < start or region_bytes - start < bytes) {
+            throw std::bad_alloc();
+        }
+
+        // pages are committed as the chunks reach them, the rest of the region costs no memory
+        const std::size_t end{start + bytes};
+
+        if (region_committed < end) {
+            const std::size_t committed{(end + page - 1) / page * page};
+
+            if (::mprotect(region + region_committed, committed - region_committed, PROT_READ | PROT_WRITE) != 0) {
+                throw std::bad_alloc();
+            }
+
+            region_committed = committed;
+        }
+
+        region_used = end;
+        return region + start;
+#else
+        region_allowed = false;
+        return nullptr;
+#endif
+    }
+
+    // Recycling mode.
+    Mode pool_mode;
+
+    // Number of slots in a regular chunk.
+    std::size_t chunk_slots;
+
+    // Size and alignment of one slot, zero until the first allocation.
+    std::size_t slot_size{0};
+    std::size_t slot_align{0};
+
+    // Head of the recycled slots list, each freed slot starts with the address of the next one.
+    std::byte *free_list{nullptr};
+
+    // Next unused slot in the current chunk, and the number of slots left in it.
+    std::byte *cursor{nullptr};
+    std::size_t chunk_left{0};
+
+    // Every chunk requested from the system, and their total size.
+    std::vector<std::byte*> chunks{};
+    std::size_t reserved_bytes{0};
+
+    // Addresses spanned by the chunks, and the largest span allowed by bound_span().
+    std::uintptr_t chunks_low{UINTPTR_MAX};
+    std::uintptr_t chunks_high{0};
+    std::size_t span_limit{SIZE_MAX};
+
+    // Address space reserved for the chunks of a bounded pool, its size, and the bytes carved & committed so far.
+    bool region_allowed{false};
+    std::byte *region{nullptr};
+    std::size_t region_bytes{0};
+    std::size_t region_used{0};
+    std::size_t region_committed{0};
+};
+
+/**
+ * std::allocator-compatible handle sharing a NodePool.
+ * Copies, including rebound copies, allocate from the same pool.
+ *
+ * @tparam T type of the allocated objects.
+ */
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    /**
+     * Creates a fresh free-list pool.
+     */
+    PoolAllocator(): pool{std::make_shared<NodePool>()} {}
+
+    /**
+     * @param pool to allocate from, shared with the caller.
+     */
+    explicit PoolAllocator(std::shared_ptr<NodePool> pool) noexcept: pool{std::move(pool)} {}
+
+    /**
+     * @param other allocator of another type whose pool is shared.
+     */
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept: pool{other.resource()} {}
+
+    /**
+     * @param count number of contiguous objects.
+     * @return storage for count objects.
+     */
+    T* allocate(std::size_t count) {
+        return static_cast<T*>(pool->allocate(sizeof(T), alignof(T), count));
+    }
+
+    /**
+     * @param pointer storage previously returned by allocate().
+     * @param count number of contiguous objects.
+     */
+    void deallocate(T *pointer, std::size_t count) noexcept {
+        pool->deallocate(pointer, sizeof(T), alignof(T), count);
+    }
+
+    /**
+     * @return the shared pool.
+     */
+    [[nodiscard]] const std::shared_ptr<NodePool>& resource() const noexcept {
+        return pool;
+    }
+
+    template <typename U>
+    friend bool operator==(const PoolAllocator& lhs, const PoolAllocator<U>& rhs) noexcept {
+        return lhs.pool == rhs.resource();
+    }
+
+    template <typename U>
+    friend bool operator!=(const PoolAllocator& lhs, const PoolAllocator<U>& rhs) noexcept {
+        return lhs.pool != rhs.resource();
+    }
+private:
+    // Pool shared by every copy of the allocator.
+    std::shared_ptr<NodePool> pool;
+};
+
+/**
+ * True if the objects of a single allocate(n) call may be deallocated one at a time,
+ * letting containers carve many nodes out of one contiguous block.
+ */
+template <typename Allocator>
+struct is_slab_allocator: std::false_type {};
+
+template <typename T>
+struct is_slab_allocator<PoolAllocator<T>>: std::true_type {};
+
+/**
+ * Bounds the span of the storage a slab allocator hands out, see NodePool::bound_span().
+ *
+ * @param bytes size of one object.
+ * @param alignment alignment of one object.
+ * @param span largest distance between two objects, in bytes.
+ * @return false if the allocator cannot guarantee the span.
+ */
+template <typename Allocator>
+bool boundSlabSpan(const Allocator&, std::size_t, std::size_t, std::size_t) {
+    return false;
+}
+
+template <typename T>
+bool boundSlabSpan(const PoolAllocator<T>& allocator, std::size_t bytes, std::size_t alignment, std::size_t span) {
+    return allocator.resource()->bound_span(bytes, alignment, span);
+}
+
+/**
+ * Allocator for a container used concurrently with the one of the given allocator,
+ * such as another shard of a ShardedAVL. Copies of other allocators must be safe to use
+ * from different threads, as std::allocator is.
+ *
+ * @param allocator to be copied.
+ * @return a copy of the allocator.
+ */
+template <typename Allocator>
+Allocator independentAllocator(const Allocator& allocator) {
+    return allocator;
+}
+
+/**
+ * Pools are not thread-safe, the copy allocates from a fresh pool of the same mode & chunk size.
+ */
+template <typename T>
+PoolAllocator<T> independentAllocator(const PoolAllocator<T>& allocator) {
+    const auto& pool{*allocator.resource()};
+    return PoolAllocator<T>(std::make_shared<NodePool>(pool.mode(), pool.slots_per_chunk()));
+}
+
+/**
+ * @tparam T type of the allocated objects.
+ * @param slots_per_chunk number of slots in each chunk requested from the system.
+ * @return allocator over a fresh arena, which is released when its last copy is dropped.
+ */
+template <typename T>
+PoolAllocator<T> makeArenaAllocator(std::size_t slots_per_chunk = 1024) {
+    return PoolAllocator<T>(std::make_shared<NodePool>(NodePool::Mode::Arena, slots_per_chunk));
+}
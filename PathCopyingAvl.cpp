@@ -0,0 +1,172 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <utility>
+
+
+/**
+ * Path-copying AVL updates shared by the trees whose published nodes are never modified.
+ * An update copies the nodes on the path it modifies, & the shared nodes a rotation touches,
+ * leaving the previous version intact.
+ *
+ * The derived tree provides, to this class as a friend:
+ * NodeHandle: type returned for a new version of a subtree, owning it if the tree counts references.
+ * makeNode(key, left, right): handle to a new node, left & right being borrowed.
+ * share(node): handle to an existing subtree, reused as is by the new version.
+ * replace(node): called with every node of the old version the new version no longer reaches.
+ * address(handle): the node of a handle.
+ * height(node): height of a node, 0 for nullptr.
+ * comparator: ordering of the keys.
+ *
+ * @tparam Derived tree class, deriving from PathCopyingAVL<Derived>.
+ */
+template <typename Derived>
+class PathCopyingAVL {
+protected:
+    /**
+     * Builds a balanced copy of a node over new children, copying the shared nodes a rotation touches.
+     *
+     * @param source node whose key is copied, replaced by the result.
+     * @param left new left child, borrowed, in balance or off by two at most.
+     * @param right new right child, borrowed.
+     * @return handle to the root of the rebuilt subtree.
+     */
+    template <typename Node, typename D = Derived>
+    typename D::NodeHandle balance(Node *source, Node *left, Node *right) {
+        auto& tree{self()};
+        tree.replace(source);
+
+        if (D::height(right) + 1 < D::height(left)) {
+            tree.replace(left);
+
+            if (D::height(left->right) <= D::height(left->left)) {
+                const auto lowered{tree.makeNode(source->key, left->right, right)};
+                return tree.makeNode(left->key, left->left, D::address(lowered));
+            }
+
+            Node *middle{left->right};
+            tree.replace(middle);
+
+            const auto new_left{tree.makeNode(left->key, left->left, middle->left)};
+            const auto new_right{tree.makeNode(source->key, middle->right, right)};
+
+            return tree.makeNode(middle->key, D::address(new_left), D::address(new_right));
+        }
+
+        if (D::height(left) + 1 < D::height(right)) {
+            tree.replace(right);
+
+            if (D::height(right->left) <= D::height(right->right)) {
+                const auto lowered{tree.makeNode(source->key, left, right->left)};
+                return tree.makeNode(right->key, D::address(lowered), right->right);
+            }
+
+            Node *middle{right->left};
+            tree.replace(middle);
+
+            const auto new_left{tree.makeNode(source->key, left, middle->left)};
+            const auto new_right{tree.makeNode(right->key, middle->right, right->right)};
+
+            return tree.makeNode(middle->key, D::address(new_left), D::address(new_right));
+        }
+
+        return tree.makeNode(source->key, left, right);
+    }
+
+    /**
+     * @param node root of the subtree, the value is known to be absent from it.
+     * @param value to be inserted.
+     * @return handle to the root of the new version of the subtree.
+     */
+    template <typename Node, typename K, typename D = Derived>
+    typename D::NodeHandle insertInto(Node *node, const K& value) {
+        auto& tree{self()};
+
+        if (not node) {
+            return tree.makeNode(value, nullptr, nullptr);
+        }
+
+        if (tree.comparator(value, node->key)) {
+            const auto left{insertInto(node->left, value)};
+            return balance(node, D::address(left), node->right);
+        }
+
+        const auto right{insertInto(node->right, value)};
+        return balance(node, node->left, D::address(right));
+    }
+
+    /**
+     * @param node root of a non-empty subtree.
+     * @return handle to the new version of the subtree without its smallest node,
+     *         & that node, still to be replaced.
+     */
+    template <typename Node, typename D = Derived>
+    std::pair<typename D::NodeHandle, Node*> removeMinimum(Node *node) {
+        auto& tree{self()};
+
+        if (not node->left) {
+            return {tree.share(node->right), node};
+        }
+
+        auto [rest, minimum] = removeMinimum(node->left);
+        return {balance(node, D::address(rest), node->right), minimum};
+    }
+
+    /**
+     * @param node root of the subtree, the value is known to be present in it.
+     * @param value to be removed.
+     * @return handle to the root of the new version of the subtree.
+     */
+    template <typename Node, typename K, typename D = Derived>
+    typename D::NodeHandle removeFrom(Node *node, const K& value) {
+        auto& tree{self()};
+
+        if (tree.comparator(value, node->key)) {
+            const auto left{removeFrom(node->left, value)};
+            return balance(node, D::address(left), node->right);
+        }
+
+        if (tree.comparator(node->key, value)) {
+            const auto right{removeFrom(node->right, value)};
+            return balance(node, node->left, D::address(right));
+        }
+
+        tree.replace(node);
+
+        if (not node->left or not node->right) {
+            return tree.share(node->left ? node->left : node->right);
+        }
+
+        // the in-order successor takes the place of the removed node
+        auto [rest, successor] = removeMinimum(node->right);
+        return balance(successor, node->left, D::address(rest));
+    }
+private:
+    Derived& self() {
+        return static_cast<Derived&>(*this);
+    }
+};
@@ -0,0 +1,403 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "PathCopyingAvl.cpp"
+
+
+/**
+ * Persistent AVL tree, every version shares the subtrees it did not modify.
+ *
+ * Nodes are immutable & reference counted. insert() & remove() copy the O(log n) nodes
+ * on the modified path, snapshot() is O(1). Distinct versions may be read & modified
+ * from different threads without any lock, as long as the allocator is thread-safe.
+ * A single version is not safe to modify while it is being read.
+ *
+ * @tparam T type of the data stored in the tree, copy constructible.
+ * @tparam Compare strict weak ordering of the keys.
+ * @tparam Allocator std::allocator-compatible allocator, rebound to allocate the nodes.
+ */
+template <typename T, typename Compare = std::less<T>, typename Allocator = std::allocator<T>>
+class PersistentAVL: private PathCopyingAVL<PersistentAVL<T, Compare, Allocator>> {
+public:
+    /* Custom size type for the AVL tree */
+    typedef long long size_type;
+
+    /**
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes of every version.
+     */
+    explicit PersistentAVL(const Compare& comp = Compare(), const Allocator& alloc = Allocator()):
+        comparator{comp}, node_allocator{alloc} {}
+
+    /**
+     * Shares every node of the other version, in O(1).
+     *
+     * @param other version to be copied.
+     */
+    PersistentAVL(const PersistentAVL& other):
+        comparator{other.comparator}, node_allocator{other.node_allocator},
+        root{acquire(other.root)}, count{other.count} {}
+
+    PersistentAVL(PersistentAVL&& other) noexcept:
+        comparator{other.comparator}, node_allocator{other.node_allocator},
+        root{std::exchange(other.root, nullptr)}, count{std::exchange(other.count, 0)} {}
+
+    PersistentAVL& operator=(PersistentAVL other) noexcept {
+        std::swap(comparator, other.comparator);
+        std::swap(node_allocator, other.node_allocator);
+        std::swap(root, other.root);
+        std::swap(count, other.count);
+        return *this;
+    }
+
+    ~PersistentAVL() {
+        release(root);
+    }
+
+    /**
+     * @return the current version, sharing every node with this one, in O(1).
+     */
+    [[nodiscard]] PersistentAVL snapshot() const {
+        return *this;
+    }
+
+    /**
+     * @param value to be inserted, copied only if it is not present.
+     * @return true if the value was inserted.
+     */
+    bool insert(const T& value) {
+        if (search(value)) {
+            return false;
+        }
+
+        replaceRoot(this->insertInto(root, value));
+        ++count;
+
+        return true;
+    }
+
+    /**
+     * @param value to be deleted, if present.
+     * @return true if the value was removed.
+     */
+    bool remove(const T& value) {
+        if (not search(value)) {
+            return false;
+        }
+
+        replaceRoot(this->removeFrom(root, value));
+        --count;
+
+        return true;
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return pointer to the key equivalent to value, valid until this version is modified or destroyed.
+     *         nullptr if absent.
+     */
+    [[nodiscard]] const T* search(const T& value) const {
+        // one comparison per level, equality is only checked against the last candidate
+        const Node *candidate{nullptr};
+        const Node *current{root};
+
+        while (current) {
+            if (comparator(current->key, value)) {
+                current = current->right;
+            } else {
+                candidate = current;
+                current = current->left;
+            }
+        }
+
+        return candidate and not comparator(value, candidate->key) ? &candidate->key : nullptr;
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return true if the value is present.
+     */
+    [[nodiscard]] bool contains(const T& value) const {
+        return search(value);
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return pointer to the first key not before value, nullptr if there is none.
+     */
+    [[nodiscard]] const T* lower_bound(const T& value) const {
+        return boundKey(value, false);
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return pointer to the first key after value, nullptr if there is none.
+     */
+    [[nodiscard]] const T* upper_bound(const T& value) const {
+        return boundKey(value, true);
+    }
+
+    /**
+     * @param visit called with every key of this version, in order.
+     */
+    template <typename Visit>
+    void for_each(Visit&& visit) const {
+        visitSubtree(root, visit);
+    }
+
+    /**
+     * @return number of keys in this version.
+     */
+    [[nodiscard]] size_type size() const {
+        return count;
+    }
+
+    /**
+     * @return true if this version holds no key.
+     */
+    [[nodiscard]] bool empty() const {
+        return not root;
+    }
+
+    /**
+     * @return the height of this version.
+     */
+    [[nodiscard]] size_type height() const {
+        return height(root);
+    }
+private:
+    friend class PathCopyingAVL<PersistentAVL>;
+
+    /**
+     * Immutable node, owning a reference to each of its children.
+     */
+    struct Node {
+        /**
+         * @param key copied into the node.
+         * @param left child of the node, already acquired.
+         * @param right child of the node, already acquired.
+         */
+        Node(const T& key, Node *left, Node *right):
+            key(key), height{static_cast<signed char>(1 + std::max(PersistentAVL::height(left), PersistentAVL::height(right)))},
+            left{left}, right{right} {}
+
+        T key;
+        signed char height;
+        Node *left;
+        Node *right;
+
+        // Number of parents & versions referencing the node.
+        mutable std::atomic<std::uint32_t> references{1};
+    };
+
+    // Allocator rebound to the node type, and its traits.
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+    /**
+     * Owned reference to a node, released when dropped, so partial copies are freed on exception.
+     */
+    class NodeRef {
+    public:
+        /**
+         * @param node owned reference, may be nullptr.
+         * @param tree whose allocator frees the node.
+         */
+        NodeRef(Node *node, PersistentAVL& tree): node{node}, tree{tree} {}
+
+        NodeRef(const NodeRef&) = delete;
+
+        NodeRef(NodeRef&& other) noexcept: node{std::exchange(other.node, nullptr)}, tree{other.tree} {}
+
+        ~NodeRef() {
+            tree.release(node);
+        }
+
+        [[nodiscard]] Node* get() const {
+            return node;
+        }
+
+        /**
+         * @return the owned reference, no longer released by this handle.
+         */
+        Node* take() {
+            return std::exchange(node, nullptr);
+        }
+    private:
+        Node *node;
+        PersistentAVL& tree;
+    };
+
+    // New versions of subtrees are owned references.
+    using NodeHandle = NodeRef;
+
+    /**
+     * @param node may be nullptr.
+     * @return the height of the node, 0 if nullptr.
+     */
+    static int height(const Node *node) {
+        return node ? node->height : 0;
+    }
+
+    /**
+     * @param node to be referenced once more, may be nullptr.
+     * @return the node.
+     */
+    static Node* acquire(Node *node) {
+        if (node) {
+            node->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return node;
+    }
+
+    /**
+     * Drops one reference to the node, destroying it & releasing its children with the last one.
+     *
+     * @param node may be nullptr.
+     */
+    void release(Node *node) {
+        if (node and node->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release(node->left);
+            release(node->right);
+            NodeTraits::destroy(node_allocator, node);
+            NodeTraits::deallocate(node_allocator, node, 1);
+        }
+    }
+
+    /**
+     * @param key copied into the new node.
+     * @param left child of the new node, borrowed.
+     * @param right child of the new node, borrowed.
+     * @return owned reference to the new node.
+     */
+    NodeRef makeNode(const T& key, Node *left, Node *right) {
+        Node *node{NodeTraits::allocate(node_allocator, 1)};
+
+        try {
+            NodeTraits::construct(node_allocator, node, key, left, right);
+        } catch (...) {
+            NodeTraits::deallocate(node_allocator, node, 1);
+            throw;
+        }
+
+        acquire(left);
+        acquire(right);
+
+        return NodeRef(node, *this);
+    }
+
+    /**
+     * @param new_root owned reference to the root of the new version.
+     */
+    void replaceRoot(NodeRef&& new_root) {
+        Node *old_root{std::exchange(root, new_root.take())};
+        release(old_root);
+    }
+
+    /**
+     * @param node subtree reused by the new version, borrowed.
+     * @return owned reference to the node.
+     */
+    NodeRef share(Node *node) {
+        return NodeRef(acquire(node), *this);
+    }
+
+    /**
+     * Nodes of the old version stay alive as long as any version references them.
+     */
+    static void replace(const Node*) {}
+
+    /**
+     * @param handle owned reference to a new version of a subtree.
+     * @return its root, borrowed.
+     */
+    static Node* address(const NodeRef& handle) {
+        return handle.get();
+    }
+
+    /**
+     * @param value bound of the search.
+     * @param after true to skip the keys equivalent to value as well.
+     * @return pointer to the first key not before value, or after it, nullptr if there is none.
+     */
+    const T* boundKey(const T& value, bool after) const {
+        const Node *result{nullptr};
+        const Node *current{root};
+
+        while (current) {
+            if (after ? comparator(value, current->key) : not comparator(current->key, value)) {
+                result = current;
+                current = current->left;
+            } else {
+                current = current->right;
+            }
+        }
+
+        return result ? &result->key : nullptr;
+    }
+
+    /**
+     * @param node root of a subtree.
+     * @param visit called with every key of the subtree, in order.
+     */
+    template <typename Visit>
+    static void visitSubtree(const Node *node, Visit& visit) {
+        if (node) {
+            visitSubtree(node->left, visit);
+            visit(node->key);
+            visitSubtree(node->right, visit);
+        }
+    }
+
+    /*
+     * Ordering of the keys.
+     */
+    Compare comparator;
+
+    /*
+     * Allocator for the nodes, shared by every version.
+     */
+    NodeAllocator node_allocator;
+
+    /*
+     * Owned reference to the root of this version.
+     */
+    Node *root{nullptr};
+
+    /*
+     * Number of keys in this version.
+     */
+    size_type count{0};
+};
@@ -0,0 +1,402 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "AvlTree.cpp"
+
+
+/**
+ * Spreads the keys over the shards by hash, balancing point operations, but not ordered:
+ * ordered scans merge every shard.
+ *
+ * @tparam T type of the keys.
+ * @tparam Hash hash function of the keys.
+ */
+template <typename T, typename Hash = std::hash<T>>
+class HashPartition {
+public:
+    /* Shard i holds no key in order after the keys of shard i + 1 */
+    static constexpr bool ordered{false};
+
+    /**
+     * @param shards number of shards, at least one.
+     * @param hash hash function of the keys.
+     */
+    explicit HashPartition(std::size_t shards, const Hash& hash = Hash()):
+        shard_count{shards ? shards : 1}, hasher{hash} {}
+
+    /**
+     * @return number of shards.
+     */
+    [[nodiscard]] std::size_t shards() const {
+        return shard_count;
+    }
+
+    /**
+     * @param key to be placed.
+     * @return index of the shard holding the key.
+     */
+    [[nodiscard]] std::size_t shard_of(const T& key) const {
+        // std::hash is often the identity, the high bits of a multiplicative mix spread better
+        const auto mixed{static_cast<std::uint64_t>(hasher(key)) * 0x9E3779B97F4A7C15ULL};
+        return static_cast<std::size_t>((mixed >> 32) % shard_count);
+    }
+private:
+    // Number of shards.
+    std::size_t shard_count;
+
+    // Hash function of the keys.
+    Hash hasher;
+};
+
+/**
+ * Splits the key space into consecutive ranges, one per shard, keeping the shards ordered.
+ *
+ * @tparam T type of the keys.
+ * @tparam Compare strict weak ordering of the keys.
+ */
+template <typename T, typename Compare = std::less<T>>
+class RangePartition {
+public:
+    /* Shard i holds no key in order after the keys of shard i + 1 */
+    static constexpr bool ordered{true};
+
+    /**
+     * @param splitters sorted keys, shard i holds the keys before splitters[i] & not before splitters[i - 1].
+     * @param comp ordering of the keys.
+     */
+    explicit RangePartition(std::vector<T> splitters, const Compare& comp = Compare()):
+        splitters{std::move(splitters)}, comparator{comp} {}
+
+    /**
+     * @return number of shards, one more than the splitters.
+     */
+    [[nodiscard]] std::size_t shards() const {
+        return splitters.size() + 1;
+    }
+
+    /**
+     * @param key to be placed.
+     * @return index of the shard holding the key.
+     */
+    [[nodiscard]] std::size_t shard_of(const T& key) const {
+        return static_cast<std::size_t>(
+            std::upper_bound(splitters.begin(), splitters.end(), key, comparator) - splitters.begin()
+        );
+    }
+private:
+    // Lower bounds of the shards after the first.
+    std::vector<T> splitters;
+
+    // Ordering of the keys.
+    Compare comparator;
+};
+
+/**
+ * Front-end partitioning the keys over independent AVL trees, each behind its own lock,
+ * so point operations on different shards never contend.
+ *
+ * Ordered operations lock the shards they read in index order, & see a consistent state.
+ * They read the shards one after the other with an ordered partition, & merge them otherwise.
+ *
+ * @tparam T type of the data stored in the trees.
+ * @tparam Partition HashPartition, RangePartition or any type with ordered, shards() & shard_of(key).
+ * @tparam Compare strict weak ordering of the keys, consistent with the partition.
+ * @tparam Allocator std::allocator-compatible allocator, rebound to allocate the nodes.
+ * @tparam NodePolicy layout of the nodes, see NodePolicy.cpp.
+ */
+template <
+    typename T,
+    typename Partition = HashPartition<T>,
+    typename Compare = std::less<T>,
+    typename Allocator = std::allocator<T>,
+    typename NodePolicy = DefaultNodePolicy
+>
+class ShardedAVL {
+public:
+    /* Tree of a single shard */
+    using tree_type = AVL<T, Compare, Allocator, NodePolicy>;
+
+    /* Custom size type for the AVL tree */
+    using size_type = typename tree_type::size_type;
+
+    /**
+     * @param partition of the keys, deciding the number of shards.
+     * @param comp ordering of the keys.
+     * @param alloc allocator used for the nodes. Writers on different shards allocate concurrently,
+     *              so every shard gets its own independentAllocator(), a fresh pool for a PoolAllocator.
+     */
+    explicit ShardedAVL(const Partition& partition, const Compare& comp = Compare(),
+                        const Allocator& alloc = Allocator()):
+        partition{partition}, comparator{comp},
+        shard_count{partition.shards()}, shards{std::make_unique<Shard[]>(shard_count)} {
+        for (std::size_t i{0}; i < shard_count; i++) {
+            shards[i].tree = tree_type(comp, independentAllocator(alloc));
+        }
+    }
+
+    /**
+     * @param value to be inserted, if not present.
+     * @return true if the value was inserted.
+     */
+    bool insert(const T& value) {
+        auto& shard{shardOf(value)};
+        std::lock_guard<std::mutex> lock{shard.mutex};
+
+        const bool inserted{shard.tree.insert(value).second};
+        shard.count.fetch_add(inserted, std::memory_order_relaxed);
+
+        return inserted;
+    }
+
+    /**
+     * @param value to be deleted, if present.
+     * @return true if the value was removed.
+     */
+    bool remove(const T& value) {
+        auto& shard{shardOf(value)};
+        std::lock_guard<std::mutex> lock{shard.mutex};
+
+        if (not shard.tree.remove(value)) {
+            return false;
+        }
+
+        shard.count.fetch_sub(1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return true if the value is present.
+     */
+    [[nodiscard]] bool contains(const T& value) const {
+        const auto& shard{shardOf(value)};
+        std::lock_guard<std::mutex> lock{shard.mutex};
+
+        return shard.tree.search(value);
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return copy of the key equivalent to value, empty if absent.
+     */
+    [[nodiscard]] std::optional<T> find(const T& value) const {
+        const auto& shard{shardOf(value)};
+        std::lock_guard<std::mutex> lock{shard.mutex};
+
+        const auto *node{shard.tree.search(value)};
+        return node ? std::optional<T>(node->key) : std::nullopt;
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return copy of the first key not before value across the shards, empty if there is none.
+     */
+    [[nodiscard]] std::optional<T> lower_bound(const T& value) const {
+        const std::size_t first{Partition::ordered ? partition.shard_of(value) : 0};
+        const auto locks{lockShards(first, shard_count)};
+        std::optional<T> result;
+
+        for (std::size_t i{first}; i < shard_count; i++) {
+            const auto position{shards[i].tree.lower_bound(value)};
+
+            if (position != shards[i].tree.end() and (not result or comparator(*position, *result))) {
+                result = *position;
+
+                // the following shards only hold larger keys
+                if constexpr (Partition::ordered) {
+                    break;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Visits every key of a consistent state, in order, through a k-way merge of the shards if needed.
+     *
+     * @param visit called with every key, the shards being locked meanwhile.
+     */
+    template <typename Visit>
+    void for_each(Visit&& visit) const {
+        const auto locks{lockShards(0, shard_count)};
+        std::vector<std::pair<typename tree_type::iterator, typename tree_type::iterator>> ranges;
+
+        for (std::size_t i{0}; i < shard_count; i++) {
+            ranges.emplace_back(shards[i].tree.begin(), shards[i].tree.end());
+        }
+
+        visitRanges(ranges, visit);
+    }
+
+    /**
+     * Visits the keys in [low, high] of a consistent state, in order.
+     * With an ordered partition, only the shards overlapping the range are locked & read.
+     *
+     * @param low smallest key visited, need not be present.
+     * @param high largest key visited, need not be present.
+     * @param visit called with every key in the range, the shards being locked meanwhile.
+     */
+    template <typename Visit>
+    void for_each_in_range(const T& low, const T& high, Visit&& visit) const {
+        if (comparator(high, low)) {
+            return;
+        }
+
+        const std::size_t first{Partition::ordered ? partition.shard_of(low) : 0};
+        const std::size_t last{Partition::ordered ? partition.shard_of(high) + 1 : shard_count};
+        const auto locks{lockShards(first, last)};
+        std::vector<std::pair<typename tree_type::range_cursor, typename tree_type::range_cursor>> ranges;
+
+        for (std::size_t i{first}; i < last; i++) {
+            const auto view{shards[i].tree.range(low, high)};
+            ranges.emplace_back(view.begin(), view.end());
+        }
+
+        visitRanges(ranges, visit);
+    }
+
+    /**
+     * @return number of keys, summed over the shards without locking them.
+     */
+    [[nodiscard]] size_type size() const {
+        size_type result{0};
+
+        for (std::size_t i{0}; i < shard_count; i++) {
+            result += shards[i].count.load(std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+
+    /**
+     * @return the partition of the keys.
+     */
+    [[nodiscard]] const Partition& get_partition() const {
+        return partition;
+    }
+private:
+    /**
+     * One tree & its lock, on cache lines of their own to avoid false sharing between shards.
+     */
+    struct alignas(64) Shard {
+        mutable std::mutex mutex{};
+        tree_type tree{};
+        std::atomic<size_type> count{0};
+    };
+
+    /**
+     * @param value key to be placed.
+     * @return the shard holding the key.
+     */
+    Shard& shardOf(const T& value) const {
+        return shards[partition.shard_of(value)];
+    }
+
+    /**
+     * @param first index of the first shard to lock.
+     * @param last index past the last shard to lock.
+     * @return locks of the shards, taken in index order.
+     */
+    std::vector<std::unique_lock<std::mutex>> lockShards(std::size_t first, std::size_t last) const {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(last - first);
+
+        for (std::size_t i{first}; i < last; i++) {
+            locks.emplace_back(shards[i].mutex);
+        }
+
+        return locks;
+    }
+
+    /**
+     * @param ranges sorted ranges, one per shard, in shard order.
+     * @param visit called with every key of the ranges, in order.
+     */
+    template <typename Ranges, typename Visit>
+    void visitRanges(Ranges& ranges, Visit& visit) const {
+        if constexpr (Partition::ordered) {
+            for (auto& [position, end]: ranges) {
+                for (; position != end; ++position) {
+                    visit(*position);
+                }
+            }
+        } else {
+            // min-heap of the ranges not exhausted yet, on their next key
+            std::vector<std::size_t> heap;
+
+            auto after = [&](std::size_t a, std::size_t b) {
+                return comparator(*ranges[b].first, *ranges[a].first);
+            };
+
+            for (std::size_t i{0}; i < ranges.size(); i++) {
+                if (ranges[i].first != ranges[i].second) {
+                    heap.push_back(i);
+                }
+            }
+
+            std::make_heap(heap.begin(), heap.end(), after);
+
+            while (not heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), after);
+                auto& [position, end]{ranges[heap.back()]};
+
+                visit(*position);
+
+                if (++position == end) {
+                    heap.pop_back();
+                } else {
+                    std::push_heap(heap.begin(), heap.end(), after);
+                }
+            }
+        }
+    }
+
+    // Placement of the keys.
+    Partition partition;
+
+    // Ordering of the keys.
+    Compare comparator;
+
+    // Number of shards.
+    std::size_t shard_count;
+
+    // Shards, each on its own cache lines.
+    std::unique_ptr<Shard[]> shards;
+};
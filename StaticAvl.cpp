@@ -0,0 +1,319 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+
+
+/**
+ * AVL tree of at most N keys, stored inline in fixed arrays without any heap allocation.
+ * Every operation is constexpr, so a lookup table can be built at compile time & baked into the binary:
+ *
+ *     constexpr StaticAVL<int, 4> primes{2, 3, 5, 7};
+ *     static_assert(primes.contains(5));
+ *
+ * Nodes are array slots linked by indices of the smallest type holding N, counted from 1, 0 for no node.
+ * Keys can be inserted but not removed, a slot is never reused.
+ *
+ * @tparam T type of the keys, a literal type for constant evaluation.
+ * @tparam N capacity of the tree.
+ * @tparam Compare strict weak ordering of the keys.
+ */
+template <typename T, std::size_t N, typename Compare = std::less<T>>
+class StaticAVL {
+    static_assert(0 < N, "StaticAVL needs room for at least one key");
+public:
+    /* Custom size type for the AVL tree */
+    typedef long long size_type;
+
+    /* Ordering of the keys */
+    typedef Compare key_compare;
+
+    constexpr StaticAVL() = default;
+
+    /**
+     * @param comp ordering of the keys.
+     */
+    constexpr explicit StaticAVL(const Compare& comp): comparator{comp} {}
+
+    /**
+     * @param values to be inserted, duplicates are skipped.
+     * @param comp ordering of the keys.
+     * @throws length_error if the distinct values do not fit in N slots.
+     */
+    constexpr StaticAVL(std::initializer_list<T> values, const Compare& comp = Compare()): comparator{comp} {
+        for (const auto& value: values) {
+            insert(value);
+        }
+    }
+
+    /**
+     * @param value to be inserted, copied only if it is not present.
+     * @return true if it was inserted.
+     * @throws length_error if the value is absent & the tree is full.
+     */
+    constexpr bool insert(const T& value) {
+        bool inserted{false};
+        root = insertNode(root, value, inserted);
+        return inserted;
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return pointer to the key equivalent to value, nullptr if absent.
+     */
+    [[nodiscard]] constexpr const T* search(const T& value) const {
+        const T *candidate{lower_bound(value)};
+        return candidate and not comparator(value, *candidate) ? candidate : nullptr;
+    }
+
+    /**
+     * @param value to be searched for.
+     * @return true if the value is present.
+     */
+    [[nodiscard]] constexpr bool contains(const T& value) const {
+        return search(value) != nullptr;
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return pointer to the first key not before value, nullptr if there is none.
+     */
+    [[nodiscard]] constexpr const T* lower_bound(const T& value) const {
+        Index result{0};
+
+        for (Index k{root}; k;) {
+            if (comparator(keys[k - 1], value)) {
+                k = right[k - 1];
+            } else {
+                result = k;
+                k = left[k - 1];
+            }
+        }
+
+        return result ? &keys[result - 1] : nullptr;
+    }
+
+    /**
+     * @param value bound of the search.
+     * @return pointer to the first key after value, nullptr if there is none.
+     */
+    [[nodiscard]] constexpr const T* upper_bound(const T& value) const {
+        Index result{0};
+
+        for (Index k{root}; k;) {
+            if (comparator(value, keys[k - 1])) {
+                result = k;
+                k = left[k - 1];
+            } else {
+                k = right[k - 1];
+            }
+        }
+
+        return result ? &keys[result - 1] : nullptr;
+    }
+
+    /**
+     * @param visit called with every key, in order.
+     */
+    template <typename Visit>
+    constexpr void for_each(Visit&& visit) const {
+        // the height of an AVL tree of N keys stays below 1.45 log2(N + 2), twice the index width is ample
+        Index stack[2 * 8 * sizeof(Index) + 2]{};
+        std::size_t depth{0};
+        Index k{root};
+
+        while (k or depth) {
+            for (; k; k = left[k - 1]) {
+                stack[depth++] = k;
+            }
+
+            k = stack[--depth];
+            visit(keys[k - 1]);
+            k = right[k - 1];
+        }
+    }
+
+    /**
+     * @return number of keys.
+     */
+    [[nodiscard]] constexpr size_type size() const {
+        return static_cast<size_type>(count);
+    }
+
+    /**
+     * @return true if the tree holds no key.
+     */
+    [[nodiscard]] constexpr bool empty() const {
+        return not count;
+    }
+
+    /**
+     * @return largest number of keys the tree can hold.
+     */
+    [[nodiscard]] static constexpr size_type capacity() {
+        return static_cast<size_type>(N);
+    }
+
+    /**
+     * @return height of the tree, 0 if empty.
+     */
+    [[nodiscard]] constexpr size_type height() const {
+        return height(root);
+    }
+private:
+    // Smallest unsigned type holding every slot index, 0 being no node.
+    using Index = std::conditional_t<N <= UINT8_MAX, std::uint8_t,
+                  std::conditional_t<N <= UINT16_MAX, std::uint16_t,
+                  std::conditional_t<N <= UINT32_MAX, std::uint32_t, std::uint64_t>>>;
+
+    /**
+     * @param k node, 0 for none.
+     * @return height of the subtree of the node, 0 for none.
+     */
+    [[nodiscard]] constexpr size_type height(Index k) const {
+        return k ? heights[k - 1] : 0;
+    }
+
+    /**
+     * @param k node whose height is recomputed from its children.
+     */
+    constexpr void updateNode(Index k) {
+        const auto l{height(left[k - 1])};
+        const auto r{height(right[k - 1])};
+        heights[k - 1] = static_cast<signed char>(1 + (l < r ? r : l));
+    }
+
+    /**
+     * @param k root of the subtree to be rotated.
+     * @return the new root of the subtree.
+     */
+    constexpr Index rightRotation(Index k) {
+        const Index head{left[k - 1]};
+        left[k - 1] = right[head - 1];
+        right[head - 1] = k;
+
+        updateNode(k);
+        updateNode(head);
+
+        return head;
+    }
+
+    /**
+     * @param k root of the subtree to be rotated.
+     * @return the new root of the subtree.
+     */
+    constexpr Index leftRotation(Index k) {
+        const Index head{right[k - 1]};
+        right[k - 1] = left[head - 1];
+        left[head - 1] = k;
+
+        updateNode(k);
+        updateNode(head);
+
+        return head;
+    }
+
+    /**
+     * @param k root of a subtree whose children are balanced, and differ in height by at most 2.
+     * @return the new root of the subtree.
+     */
+    constexpr Index rebalance(Index k) {
+        const auto balance{height(left[k - 1]) - height(right[k - 1])};
+
+        if (1 < balance) {
+            if (height(left[left[k - 1] - 1]) < height(right[left[k - 1] - 1])) {
+                left[k - 1] = leftRotation(left[k - 1]);
+            }
+
+            return rightRotation(k);
+        }
+
+        if (balance < -1) {
+            if (height(right[right[k - 1] - 1]) < height(left[right[k - 1] - 1])) {
+                right[k - 1] = rightRotation(right[k - 1]);
+            }
+
+            return leftRotation(k);
+        }
+
+        updateNode(k);
+
+        return k;
+    }
+
+    /**
+     * @param k root of the subtree to insert into, 0 for none.
+     * @param value to be inserted.
+     * @param inserted set to true if the value was not present.
+     * @return the new root of the subtree.
+     */
+    constexpr Index insertNode(Index k, const T& value, bool& inserted) {
+        if (not k) {
+            if (count == N) {
+                throw std::length_error("StaticAVL: capacity exceeded");
+            }
+
+            k = static_cast<Index>(++count);
+            keys[k - 1] = value;
+            heights[k - 1] = 1;
+            inserted = true;
+
+            return k;
+        }
+
+        if (comparator(value, keys[k - 1])) {
+            left[k - 1] = insertNode(left[k - 1], value, inserted);
+        } else if (comparator(keys[k - 1], value)) {
+            right[k - 1] = insertNode(right[k - 1], value, inserted);
+        } else {
+            // Duplicates are not inserted
+            return k;
+        }
+
+        return rebalance(k);
+    }
+
+    // Ordering of the keys.
+    Compare comparator{};
+
+    // Slot k - 1 holds the key, children & subtree height of node k, slots are filled in insertion order.
+    T keys[N]{};
+    Index left[N]{};
+    Index right[N]{};
+    signed char heights[N]{};
+
+    // Root node, 0 for an empty tree.
+    Index root{0};
+
+    // Number of slots in use.
+    std::size_t count{0};
+};
@@ -0,0 +1,316 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#include "NodePool.cpp"
+
+
+/**
+ * Point-in-time copy of the counters of a TreeStatistics.
+ */
+struct TreeStatisticsSnapshot {
+    // Number of histogram buckets, the last one also counts the deeper searches.
+    static constexpr std::size_t depth_buckets{64};
+
+    // Rotations performed while rebalancing after insertions & removals, a double rotation counts once.
+    std::uint64_t single_rotations{0};
+    std::uint64_t double_rotations{0};
+
+    // Number of searches, and how many of them visited each number of nodes.
+    std::uint64_t searches{0};
+    std::array<std::uint64_t, depth_buckets> search_depths{};
+
+    // Nodes & bytes currently allocated.
+    std::int64_t live_nodes{0};
+    std::int64_t live_bytes{0};
+
+    /**
+     * @return mean number of nodes visited per search, 0 without searches.
+     */
+    [[nodiscard]] double mean_search_depth() const {
+        if (not searches) {
+            return 0;
+        }
+
+        double total{0};
+
+        for (std::size_t depth{0}; depth < depth_buckets; depth++) {
+            total += static_cast<double>(depth) * static_cast<double>(search_depths[depth]);
+        }
+
+        return total / static_cast<double>(searches);
+    }
+
+    /**
+     * @param quantile fraction of the searches, in [0, 1].
+     * @return smallest depth reached by at least that fraction of the searches.
+     */
+    [[nodiscard]] std::size_t search_depth_quantile(double quantile) const {
+        const auto wanted{static_cast<double>(searches) * quantile};
+        std::uint64_t reached{0};
+
+        for (std::size_t depth{0}; depth < depth_buckets; depth++) {
+            reached += search_depths[depth];
+
+            if (wanted <= static_cast<double>(reached)) {
+                return depth;
+            }
+        }
+
+        return depth_buckets - 1;
+    }
+};
+
+/**
+ * Counters of a tree, cheap enough to be left on in production.
+ * Updates are relaxed atomic increments, spread over stripes picked by thread
+ * so that threads working on trees sharing the statistics rarely touch the same cache line.
+ */
+class TreeStatistics {
+public:
+    /**
+     * @param is_double true for a double rotation.
+     */
+    void record_rotation(bool is_double) noexcept {
+        auto& counter{is_double ? local().double_rotations : local().single_rotations};
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @param depth number of nodes visited by the search.
+     */
+    void record_search(std::size_t depth) noexcept {
+        const std::size_t bucket{depth < TreeStatisticsSnapshot::depth_buckets ? depth : TreeStatisticsSnapshot::depth_buckets - 1};
+        local().search_depths[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @param nodes number of nodes allocated, negative for a deallocation.
+     * @param bytes number of bytes allocated, negative for a deallocation.
+     */
+    void record_allocation(std::int64_t nodes, std::int64_t bytes) noexcept {
+        auto& stripe{local()};
+        stripe.live_nodes.fetch_add(nodes, std::memory_order_relaxed);
+        stripe.live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    /**
+     * Counters updated concurrently may be caught halfway, each one is exact on its own.
+     *
+     * @return sum of the counters of every stripe.
+     */
+    [[nodiscard]] TreeStatisticsSnapshot snapshot() const noexcept {
+        TreeStatisticsSnapshot result;
+
+        for (const auto& stripe: stripes) {
+            result.single_rotations += stripe.single_rotations.load(std::memory_order_relaxed);
+            result.double_rotations += stripe.double_rotations.load(std::memory_order_relaxed);
+            result.live_nodes += stripe.live_nodes.load(std::memory_order_relaxed);
+            result.live_bytes += stripe.live_bytes.load(std::memory_order_relaxed);
+
+            for (std::size_t depth{0}; depth < TreeStatisticsSnapshot::depth_buckets; depth++) {
+                const auto searches{stripe.search_depths[depth].load(std::memory_order_relaxed)};
+                result.search_depths[depth] += searches;
+                result.searches += searches;
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Clears the rotation & search counters, the live counters keep tracking the allocations.
+     */
+    void reset() noexcept {
+        for (auto& stripe: stripes) {
+            stripe.single_rotations.store(0, std::memory_order_relaxed);
+            stripe.double_rotations.store(0, std::memory_order_relaxed);
+
+            for (auto& searches: stripe.search_depths) {
+                searches.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+private:
+    // Number of stripes, threads hash onto them.
+    static constexpr std::size_t stripe_count{8};
+
+    /**
+     * Counters updated by a subset of the threads, on their own cache lines.
+     */
+    struct alignas(64) Stripe {
+        std::atomic<std::uint64_t> single_rotations{0};
+        std::atomic<std::uint64_t> double_rotations{0};
+        std::atomic<std::int64_t> live_nodes{0};
+        std::atomic<std::int64_t> live_bytes{0};
+        std::array<std::atomic<std::uint64_t>, TreeStatisticsSnapshot::depth_buckets> search_depths{};
+    };
+
+    /**
+     * @return stripe of the calling thread.
+     */
+    Stripe& local() noexcept {
+        static thread_local const std::size_t index{std::hash<std::thread::id>{}(std::this_thread::get_id()) % stripe_count};
+        return stripes[index];
+    }
+
+    Stripe stripes[stripe_count]{};
+};
+
+/**
+ * Allocator adapter recording the nodes & bytes it holds into a TreeStatistics.
+ * A tree using it also records its rotations & search depths there, see AVL::stats().
+ * Copies, including rebound copies, share the statistics of the original.
+ *
+ * @tparam Allocator std::allocator-compatible allocator doing the actual allocations.
+ */
+template <typename Allocator>
+class InstrumentedAllocator {
+    using Traits = std::allocator_traits<Allocator>;
+public:
+    using value_type = typename Traits::value_type;
+
+    using propagate_on_container_copy_assignment = typename Traits::propagate_on_container_copy_assignment;
+    using propagate_on_container_move_assignment = typename Traits::propagate_on_container_move_assignment;
+    using propagate_on_container_swap = typename Traits::propagate_on_container_swap;
+    using is_always_equal = std::false_type;
+
+    template <typename U>
+    struct rebind {
+        using other = InstrumentedAllocator<typename Traits::template rebind_alloc<U>>;
+    };
+
+    /**
+     * Wraps a default constructed allocator, with fresh statistics.
+     */
+    InstrumentedAllocator(): counters{std::make_shared<TreeStatistics>()} {}
+
+    /**
+     * @param inner allocator doing the actual allocations.
+     * @param counters statistics to record into, fresh ones if omitted.
+     */
+    explicit InstrumentedAllocator(const Allocator& inner,
+                                   std::shared_ptr<TreeStatistics> counters = std::make_shared<TreeStatistics>()):
+        inner{inner}, counters{std::move(counters)} {}
+
+    /**
+     * @param other allocator of another type whose statistics are shared.
+     */
+    template <typename Other>
+    InstrumentedAllocator(const InstrumentedAllocator<Other>& other) noexcept:
+        inner{other.base()}, counters{other.statistics()} {}
+
+    /**
+     * @param count number of contiguous objects.
+     * @return storage for count objects.
+     */
+    value_type* allocate(std::size_t count) {
+        value_type *pointer{Traits::allocate(inner, count)};
+        counters->record_allocation(static_cast<std::int64_t>(count), static_cast<std::int64_t>(count * sizeof(value_type)));
+        return pointer;
+    }
+
+    /**
+     * @param pointer storage previously returned by allocate().
+     * @param count number of contiguous objects.
+     */
+    void deallocate(value_type *pointer, std::size_t count) noexcept {
+        Traits::deallocate(inner, pointer, count);
+        counters->record_allocation(-static_cast<std::int64_t>(count), -static_cast<std::int64_t>(count * sizeof(value_type)));
+    }
+
+    /**
+     * @return allocator for a copy of a container, with fresh statistics.
+     */
+    [[nodiscard]] InstrumentedAllocator select_on_container_copy_construction() const {
+        return InstrumentedAllocator(Traits::select_on_container_copy_construction(inner));
+    }
+
+    /**
+     * @return the wrapped allocator.
+     */
+    [[nodiscard]] const Allocator& base() const noexcept {
+        return inner;
+    }
+
+    /**
+     * @return the shared statistics.
+     */
+    [[nodiscard]] const std::shared_ptr<TreeStatistics>& statistics() const noexcept {
+        return counters;
+    }
+
+    template <typename Other>
+    friend bool operator==(const InstrumentedAllocator& lhs, const InstrumentedAllocator<Other>& rhs) noexcept {
+        return lhs.inner == rhs.base() and lhs.counters == rhs.statistics();
+    }
+
+    template <typename Other>
+    friend bool operator!=(const InstrumentedAllocator& lhs, const InstrumentedAllocator<Other>& rhs) noexcept {
+        return not (lhs == rhs);
+    }
+private:
+    // Allocator doing the actual allocations.
+    Allocator inner;
+
+    // Statistics shared by every copy.
+    std::shared_ptr<TreeStatistics> counters;
+};
+
+/**
+ * True if the allocator records into a TreeStatistics, which turns on the instrumentation of the tree.
+ */
+template <typename Allocator>
+struct is_instrumented_allocator: std::false_type {};
+
+template <typename Allocator>
+struct is_instrumented_allocator<InstrumentedAllocator<Allocator>>: std::true_type {};
+
+template <typename Allocator>
+struct is_slab_allocator<InstrumentedAllocator<Allocator>>: is_slab_allocator<Allocator> {};
+
+/**
+ * The counters are atomic & stay shared, only the wrapped allocator is made independent.
+ */
+template <typename Allocator>
+InstrumentedAllocator<Allocator> independentAllocator(const InstrumentedAllocator<Allocator>& allocator) {
+    return InstrumentedAllocator<Allocator>(independentAllocator(allocator.base()), allocator.statistics());
+}
+
+template <typename Allocator>
+bool boundSlabSpan(const InstrumentedAllocator<Allocator>& allocator,
+                   std::size_t bytes, std::size_t alignment, std::size_t span) {
+    return boundSlabSpan(allocator.base(), bytes, alignment, span);
+}
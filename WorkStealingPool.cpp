@@ -0,0 +1,338 @@
+/*
+ * MIT License
+ *
+ *  Copyright (c) 2023 Mahmoud Yaman Ayman Seraj Alddin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+/**
+ * Fork-join thread pool, each worker owns a deque of jobs.
+ * Workers pop their own jobs from the back, & steal the oldest jobs of the others from the front.
+ * A worker waiting on a join keeps running jobs instead of blocking.
+ */
+class WorkStealingPool {
+public:
+    /**
+     * @param threads number of worker threads, at least one.
+     */
+    explicit WorkStealingPool(std::size_t threads = std::thread::hardware_concurrency()) {
+        threads = threads ? threads : 1;
+
+        for (std::size_t i{0}; i < threads; i++) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+
+        for (std::size_t i{0}; i < threads; i++) {
+            this->threads.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock{idle_mutex};
+            stopping = true;
+        }
+
+        idle.notify_all();
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+
+    /**
+     * @return number of worker threads.
+     */
+    [[nodiscard]] std::size_t size() const noexcept {
+        return workers.size();
+    }
+
+    /**
+     * @return index of the calling worker in [0, size()), only meaningful inside the pool.
+     */
+    [[nodiscard]] std::size_t current_worker() const noexcept {
+        return current_pool == this ? current_index : 0;
+    }
+
+    /**
+     * Runs the function on a worker of the pool & blocks until it returns.
+     *
+     * @param function to be run, can fork_join() further.
+     */
+    template <typename Function>
+    void run(Function&& function) {
+        if (current_pool == this) {
+            function();
+            return;
+        }
+
+        std::promise<void> finished;
+        auto body = [&] {
+            try {
+                function();
+                finished.set_value();
+            } catch (...) {
+                finished.set_exception(std::current_exception());
+            }
+        };
+
+        // the caller may return as soon as the promise is set, so the job owns itself
+        auto future{finished.get_future()};
+        auto job{std::make_unique<DetachedJob<decltype(body)>>(std::move(body))};
+        push(0, job.get());
+        job.release();
+        future.get();
+    }
+
+    /**
+     * Runs both functions, possibly in parallel, & returns once both are done.
+     * The right one is offered to thieves while the calling worker runs the left one.
+     * Exceptions are rethrown after both are done, the left one first.
+     *
+     * @param left function run by the calling thread.
+     * @param right function run by any worker.
+     */
+    template <typename Left, typename Right>
+    void fork_join(Left&& left, Right&& right) {
+        if (current_pool != this) {
+            run([&] { fork_join(left, right); });
+            return;
+        }
+
+        FunctionJob<Right> job{right};
+        push(current_index, &job);
+
+        std::exception_ptr left_error{};
+
+        try {
+            left();
+        } catch (...) {
+            left_error = std::current_exception();
+        }
+
+        // the job is still on top of the own deque unless it was stolen
+        while (not job.done.load(std::memory_order_acquire)) {
+            if (not runOne(current_index)) {
+                std::this_thread::yield();
+            }
+        }
+
+        if (left_error) {
+            std::rethrow_exception(left_error);
+        }
+
+        if (job.error) {
+            std::rethrow_exception(job.error);
+        }
+    }
+private:
+    /**
+     * Unit of work, lives on the stack of the forking thread until it is done.
+     */
+    struct Job {
+        virtual ~Job() = default;
+
+        virtual void execute() = 0;
+
+        // True if the job is deleted by the worker running it, instead of being waited on.
+        bool detached{false};
+
+        // Set once the job has been executed.
+        std::atomic<bool> done{false};
+
+        // Exception thrown by the job, if any.
+        std::exception_ptr error{};
+    };
+
+    /**
+     * @tparam Function callable type of the job.
+     */
+    template <typename Function>
+    struct FunctionJob: Job {
+        explicit FunctionJob(Function& function): function{function} {}
+
+        void execute() override {
+            function();
+        }
+
+        Function& function;
+    };
+
+    /**
+     * Job allocated on the heap, owning its function.
+     *
+     * @tparam Function callable type of the job.
+     */
+    template <typename Function>
+    struct DetachedJob: Job {
+        explicit DetachedJob(Function&& function): function{std::move(function)} {
+            this->detached = true;
+        }
+
+        void execute() override {
+            function();
+        }
+
+        Function function;
+    };
+
+    /**
+     * Deque of jobs owned by one worker.
+     */
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Job*> jobs;
+    };
+
+    /**
+     * @param index of the worker whose deque receives the job.
+     * @param job to be queued.
+     */
+    void push(std::size_t index, Job *job) {
+        {
+            std::lock_guard<std::mutex> lock{workers[index]->mutex};
+            workers[index]->jobs.push_back(job);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{idle_mutex};
+            ++pending;
+        }
+
+        idle.notify_one();
+    }
+
+    /**
+     * @param index of the worker looking for a job.
+     * @return the newest own job, or the oldest job of another worker, nullptr if there is none.
+     */
+    Job* take(std::size_t index) {
+        {
+            auto& own{*workers[index]};
+            std::lock_guard<std::mutex> lock{own.mutex};
+
+            if (not own.jobs.empty()) {
+                Job *job{own.jobs.back()};
+                own.jobs.pop_back();
+                return job;
+            }
+        }
+
+        for (std::size_t i{1}; i < workers.size(); i++) {
+            auto& victim{*workers[(index + i) % workers.size()]};
+            std::lock_guard<std::mutex> lock{victim.mutex};
+
+            if (not victim.jobs.empty()) {
+                Job *job{victim.jobs.front()};
+                victim.jobs.pop_front();
+                return job;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * @param index of the calling worker.
+     * @return true if a job was found & executed.
+     */
+    bool runOne(std::size_t index) {
+        Job *job{take(index)};
+
+        if (not job) {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{idle_mutex};
+            --pending;
+        }
+
+        try {
+            job->execute();
+        } catch (...) {
+            job->error = std::current_exception();
+        }
+
+        if (job->detached) {
+            delete job;
+        } else {
+            job->done.store(true, std::memory_order_release);
+        }
+
+        return true;
+    }
+
+    /**
+     * @param index of the worker running the loop.
+     */
+    void workerLoop(std::size_t index) {
+        current_pool = this;
+        current_index = index;
+
+        while (true) {
+            if (runOne(index)) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock{idle_mutex};
+            idle.wait(lock, [this] { return stopping or pending; });
+
+            if (stopping and not pending) {
+                return;
+            }
+        }
+    }
+
+    // Pool & worker index of the calling thread, if it is a worker.
+    static inline thread_local const WorkStealingPool *current_pool{nullptr};
+    static inline thread_local std::size_t current_index{0};
+
+    // Job deques, one per worker.
+    std::vector<std::unique_ptr<Worker>> workers{};
+
+    // Worker threads.
+    std::vector<std::thread> threads{};
+
+    // Idle workers sleep until a job is queued or the pool stops.
+    std::mutex idle_mutex{};
+    std::condition_variable idle{};
+    std::size_t pending{0};
+    bool stopping{false};
+};